@@ -5,6 +5,15 @@
 
 const unsigned char UBX_HEADER[] = { 0xB5, 0x62 };
 
+const unsigned char NAV_CLASS = 0x01;
+const unsigned char NAV_PVT_ID = 0x07;
+const unsigned char NAV_VELNED_ID = 0x12;
+const unsigned char ACK_CLASS = 0x05;
+const unsigned char ACK_NAK_ID = 0x00;
+const unsigned char ACK_ACK_ID = 0x01;
+const unsigned char HNR_CLASS = 0x28;
+const unsigned char HNR_PVT_ID = 0x00;
+
 struct NAV_PVT {
     unsigned char   cls;
     unsigned char   id;
@@ -61,14 +70,54 @@ struct NAV_VELNED {
     unsigned char   id;
     unsigned short  len;
     unsigned long   iTOW;
-    long            velN;
-    long            velE;
-    long            velD;
-    unsigned long   spd;
-    unsigned long   gSpd;
-    long            hdg;
-    unsigned long   sAcc;
-    unsigned long   hAcc;
+    long            velN; //NED North Velocity, cm/s
+    long            velE; //NED East Velocity, cm/s
+    long            velD; //NED Down Velocity, cm/s
+    unsigned long   spd; //Speed (3-D), cm/s
+    unsigned long   gSpd; //Ground speed (2-D), cm/s
+    long            hdg; //Heading of motion
+    unsigned long   sAcc; //Speed accuracy estimate, cm/s
+    unsigned long   cAcc; //Course accuracy estimate
+};
+
+//High navigation rate output (M8U/M8L), fused with the IMU
+struct HNR_PVT {
+    unsigned char   cls;
+    unsigned char   id;
+    unsigned short  len;
+    unsigned long   iTOW;
+    uint16_t        year;
+    uint8_t         month;
+    uint8_t         day;
+    uint8_t         hour;
+    uint8_t         min;
+    uint8_t         sec;
+    unsigned char   valid;
+    long            nano;
+    uint8_t         gpsFix; //Same values as NAV_PVT fixType
+    unsigned char   flags;
+    uint8_t         reserved1[2];
+    long            lon; //Longitude. Scaling: 1e-7
+    long            lat; //Latitude. Scaling: 1e-7
+    long            height; //Height above ellipsoid
+    long            hMSL; //Height above mean sea level
+    long            gSpeed; //Ground speed (2-D), mm/s
+    long            speed; //Speed (3-D), mm/s
+    long            headMot; //Heading of motion
+    long            headVeh; //Heading of vehicle
+    unsigned long   hAcc; //Horizontal accuracy estimate
+    unsigned long   vAcc; //Vertical accuracy estimate
+    unsigned long   sAcc; //Speed accuracy estimate
+    unsigned long   headAcc; //Heading accuracy estimate
+    uint8_t         reserved2[4];
+};
+
+struct ACK_ACK {
+    unsigned char   cls;
+    unsigned char   id;
+    unsigned short  len;
+    unsigned char   clsID; //Class of the acknowledged message
+    unsigned char   msgID; //Id of the acknowledged message
 };
 
 #endif
\ No newline at end of file
@@ -8,6 +8,11 @@
 #include <EEPROM.h>
 #include <WString.h>
 #include "nextionDisplay.h"
+#include "telemetry.h"
+#include "derived.h"
+#include "sensors.h"
+#include "statusQueue.h"
+#include "settings.h"
 
 
 #define DEBUG Serial
@@ -20,12 +25,9 @@
   bool debug = false;
 #endif
 
-const int AUTOSTART_EEPROM = 0;
-bool autoStart = true;
-unsigned int autoStartMode = 1; //0 = speed, 1 = fixType, 2 = Power (always log)
-unsigned long autoStartSpeedThreshold = 30 * 0.277 * 1000; // 30kph -> m/s -> mm/s
-unsigned int autoStartFixType = 3; //3 = Full 3D
-unsigned long autoStartDurationThreshold = 2000; // 2sec;
+const int AUTOSTART_EEPROM = 0; //Older firmware's autostart flag, imported once
+SettingsStore config;
+LoggerSettings& settings = config.data;
 unsigned long autoStartStart = 0;
 
 unsigned long ms = 0;
@@ -35,20 +37,31 @@ unsigned long nextInputUpdate = 0;
 unsigned long nextBlink = 0;
 unsigned long nextSignal = 0;
 unsigned long nextFlush = 0;
+unsigned long nextStats = 0;
+unsigned long maxLoop = 0;
 bool blinkState = false;
 
 unsigned long signalInterval = 1000000;
 unsigned long blinkInterval = 500000;
 unsigned long drawInterval = 100000; // 100ms;
 unsigned long loggingDrawInterval = 250000; // 250ms;
-unsigned long logInterval = 4000; // 4ms;
 unsigned long inputUpdateInterval = 20000; // 20ms;
 unsigned long flushInterval = 10000000; // 10sec;
+unsigned long statsInterval = 1000000; // 1sec;
+unsigned long sdMountInterval = 30000000; // 30sec between mount attempts;
 
 int inputs[] = { A0,A1,A2,A3,A4,A5,A6,A7 };
 
+//Transfer function per analog input (see sensors.h), SENSOR_RAW logs plain counts
+const int16_t* const inputProfiles[] = {
+  SENSOR_RAW, SENSOR_RAW, SENSOR_RAW, SENSOR_RAW,
+  SENSOR_RAW, SENSOR_RAW, SENSOR_RAW, SENSOR_RAW
+};
+
 int sdCardPin = 53;
 bool sdCardInitialized = false;
+bool sdCardFailReported = false;
+unsigned long nextSdMount = 0;
 
 int toggleLoggingPin = 40;
 int enterPin = 40;
@@ -61,7 +74,10 @@ unsigned long toggleLoggingStart = 0;
 bool loggingToggled = false;
 
 File logFile;
-const uint16_t VALUE_COUNT = 14;
+uint32_t logOpenMicros = 0;
+bool timeBackfillPending = false; //Log opened without GPS time, header unixTime still 0
+const uint16_t SENSOR_COUNT = 14;
+const uint16_t VALUE_COUNT = SENSOR_COUNT + DERIVED_COUNT;
 
 struct LogLine
 {
@@ -83,16 +99,31 @@ NAV_PVT     pvt;
 
 Gps gps;
 NextionDisplay display;
+Telemetry telemetry;
+DerivedChannels derived;
+ChannelStats stats;
+StatusQueue statusQueue;
+unsigned long lastPvtTime = 0;
+int statsCursor = -1; //Next stats field to send after pollStats, -1 when idle
+const int STATS_FIELD_SIZE = 24; //Worst case bytes of one "<name>min.val=-32768" plus EOL
+int valuesCursor = -1; //Next value to send after pollValues, -1 when idle
+const int VALUES_FIELD_SIZE = 18; //Worst case bytes of one "<name>.val=-32768" plus EOL
 
 String pollValuesCmd = String("pollValues");
+String pollStatsCmd = String("pollStats");
 String toggleAutoCmd = String("toggleAuto");
 String getAutoCmd = String("getAuto");
+String toggleTelemetryCmd = String("toggleTelem");
+String getTelemetryCmd = String("getTelem");
+String getSettingsCmd = String("getSettings");
+String setCmd = String("set ");
 
 uint8_t irIds[] = {0x10,0x11,0x12,0x13,0x14,0x15};
 IRTherm ir[6];
 int16_t temp[6] = {0,0,0,0,0,0};
 bool irEnabled[6] = {false, false, false, false, false, false};
 int currentIR = 0;
+int irProbe = 0; //Next sensor to discover, 6 once discovery is done
 
 bool isLogging = false;
 bool isMenu = true;
@@ -113,13 +144,26 @@ char* channelComponentNames[] = {
   "t3", "t4", "t5", //Front temps (FL, FM, FR)
   "a0", "a1", "a2", "a3", //First set of analogs
   "a4", "a5", "a6", "a7", //Second set of analogs
+  "lonG", "latG", //Derived acceleration (milli-g)
 };
 
 
 void sendDebug(char text[])
 {
-  Serial.println(text);
-  display.debug(text);
+  if (telemetry.isEnabled())
+    telemetry.sendText(text);
+  else if (Serial.availableForWrite() >= (int)strlen(text) + 2)
+    Serial.println(text); //Dropped rather than waiting on the 9600 baud UART
+
+  statusQueue.push(text);
+}
+
+void updateStatus()
+{
+  const char* text = statusQueue.next(millis());
+
+  if (text)
+    display.debug(text);
 }
 
 void setup() {
@@ -136,100 +180,97 @@ void setup() {
 
   Serial.begin(9600);
 
-  autoStart = (EEPROM.read(AUTOSTART_EEPROM) == 0);
-
-  digitalWrite(13,LOW);
+  uint8_t settingsVersion = config.load();
 
-  delay(10);  
-  sendDebug("IR INIT");
-
-  for (int i = 0; i < 6; i++) 
+  if (settingsVersion == 0)
   {
-    if (digitalRead(enterPin) == LOW)
-    {
-      sendDebug("SKIP");
-      delay(500);
-      break;
-    }
-
-    ir[i].begin(irIds[i]);
-    ir[i].setUnit(TEMP_C);
-
-    if (ir[i].read())
-    {
-      sendDebug(irNames[i]);
-      irEnabled[i] = true;
-    }
+    //First boot with the settings store
+    settings.autoStart = (EEPROM.read(AUTOSTART_EEPROM) == 0);
+    config.save();
+  }
+  else if (settingsVersion != SETTINGS_VERSION)
+  {
+    //Written by another firmware, nothing to migrate from yet: keep the defaults
+    sendDebug("SETTINGS RESET");
+    config.save();
   }
 
-  digitalWrite(13,HIGH);
-  delay(250);
-  digitalWrite(13,LOW);
+  if (settings.telemetry)
+    telemetry.begin(settings.logInterval, sizeof(line));
 
   for (int i = 0; i < 10; i++) 
   {
     pinMode(inputs[i], INPUT);  
   }
 
+  pinMode(sdCardPin, OUTPUT);
+
   updateToggleLoggingButton();
 
-  digitalWrite(13,HIGH);
-  delay(250);
-  digitalWrite(13,LOW);
+  stats.reset(VALUE_COUNT);
+
+  //IR discovery, SD mount and GPS time are picked up by updateBoot() while sampling
+  sendDebug("IR INIT");
 
-  initSD();
   analogWrite(redLedPin,LOW);
   analogWrite(greenLedPin, 40);
 }
 
-void getGPSFix()
+// Probes one IR sensor per call so discovery never holds up a sample.
+void discoverNextIR()
 {
-  if (gps.hasTimeFix())
+  if (digitalRead(enterPin) == LOW)
+  {
+    sendDebug("SKIP");
+    irProbe = 6;
     return;
+  }
 
-  unsigned long giveUpTime = millis() + 60000;
-  int enterState = digitalRead(enterPin);
-  int previousEnterState = enterState;
+  ir[irProbe].begin(irIds[irProbe]);
+  ir[irProbe].setUnit(TEMP_C);
 
-  sendDebug("GPS FIX");
-  while (!gps.hasTimeFix())
+  if (ir[irProbe].read())
   {
-    previousEnterState = enterState;
-    enterState = digitalRead(enterPin);
-    
-    if (millis() > giveUpTime) //abort if this takes more than 1 min
-    {
-      sendDebug("TIMEOUT");
-      delay(500);
-      break;
-    }
+    sendDebug(irNames[irProbe]);
+    irEnabled[irProbe] = true;
+  }
 
-    if (enterState == LOW && previousEnterState == HIGH)
-    {
-      sendDebug("SKIP");
-      delay(500);
-      break;
-    }
+  irProbe++;
+}
 
-    gps.update();
+// Boot work that used to block setup(), one step per loop.
+void updateBoot()
+{
+  if (irProbe < 6)
+  {
+    discoverNextIR();
+    return;
+  }
 
-    delay(10);
+  //SD.begin blocks for up to ~2s without a card, so it is only retried
+  //rarely and never while logging
+  if (!sdCardInitialized && !isLogging && ms > nextSdMount)
+  {
+    nextSdMount = ms + sdMountInterval;
+    initSD();
+    return;
   }
+
+  updateTimeBackfill();
 }
 
 void initSD()
 {
-  pinMode(sdCardPin, OUTPUT);
   sdCardInitialized = SD.begin(sdCardPin);
   if (sdCardInitialized)
   {
     sendDebug("SD INIT");
-    delay(500);
   }
-  else
+  else if (!sdCardFailReported)
   {
+    //Retried in the background, only report the first failure
     sendDebug("SD FAIL");
-    delay(1000);
+    sdCardFailReported = true;
   }
 }
 
@@ -253,60 +294,85 @@ void updateIRTemps()
     currentIR = 0;
 }
 
+// Opens the next log file right away. Without GPS time the file gets an
+// undated name and a zero unixTime that updateTimeBackfill() fills in later.
 bool initLogFile()
 {
-  if (!sdCardInitialized)
-    initSD();    
-
   if (!sdCardInitialized)
   {
+    //updateBoot() keeps retrying the mount on its own schedule
     sendDebug("NO CARD");
-    delay(1000);
     return false;
   }
 
-  getGPSFix();
+  bool hasTime = gps.hasTimeFix();
+  uint32_t ms = micros();
+  uint32_t unixTime = 0;
+  String prefix = "nt-";
 
-  DateTime now = DateTime(pvt.year, pvt.month, pvt.day, pvt.hour, pvt.min, pvt.sec);
+  if (hasTime)
+  {
+    NAV_PVT fix = gps.getLatest();
+    DateTime now = DateTime(fix.year, fix.month, fix.day, fix.hour, fix.min, fix.sec);
 
-  uint32_t ms = micros();
-  uint32_t unixTime = now.unixtime();
+    unixTime = now.unixtime();
+    prefix = String(now.month()) + "-";
+    prefix = prefix + now.day() + "-";
+  }
 
-  String date = String(now.month())+"-";
-  date = date + now.day();
-  
   String extension = ".log";
   
   int counter = 0;
   
-  String filename = date + "-" + counter;
+  String filename = prefix + counter;
 
   while (SD.exists(filename + extension)) {
-    sendDebug("FILENAME");
-    char filenameBuffer[20];
-    filename.toCharArray(filenameBuffer, 20);
-    sendDebug(filenameBuffer);
     counter++;
-    filename = date + "-" + counter;
+    filename = prefix + counter;
   }
 
-  delay(500);
-  
-  logFile = SD.open(filename + extension,FILE_WRITE);
+  //No O_APPEND so the header can be rewritten once the time is known
+  logFile = SD.open(filename + extension, O_READ | O_WRITE | O_CREAT);
 
   if (logFile) {
+    char filenameBuffer[20];
+    filename.toCharArray(filenameBuffer, 20);
+    sendDebug(filenameBuffer);
+
     logFile.write((const uint8_t *)&ms, sizeof(ms));
     logFile.write((const uint8_t *)&unixTime, sizeof(unixTime));
     logFile.write((const uint8_t *)&VALUE_COUNT, sizeof(VALUE_COUNT));
     logFile.flush();
+
+    logOpenMicros = ms;
+    timeBackfillPending = !hasTime;
     return true;
   } else {
     sendDebug("NO FILE");
-    delay(1000);
     return false;
   }
 }
 
+// Writes the unix time of the file open into the header (offset 4) as soon
+// as the GPS has time, derived from the latest PVT and when it arrived.
+void updateTimeBackfill()
+{
+  if (!isLogging || !timeBackfillPending || !gps.hasTimeFix())
+    return;
+
+  NAV_PVT fix = gps.getLatest();
+  DateTime now = DateTime(fix.year, fix.month, fix.day, fix.hour, fix.min, fix.sec);
+  uint32_t unixTime = now.unixtime() - (gps.getPvtTime() - logOpenMicros) / 1000000;
+
+  uint32_t end = logFile.position();
+  logFile.seek(sizeof(uint32_t));
+  logFile.write((const uint8_t *)&unixTime, sizeof(unixTime));
+  logFile.seek(end);
+
+  timeBackfillPending = false;
+  sendDebug("TIME SET");
+}
+
 void toggleLogging()
 {
   sendDebug("ToggleLog");
@@ -315,6 +381,7 @@ void toggleLogging()
     logFile.flush();
     logFile.close();
     isLogging = false;
+    timeBackfillPending = false;
     digitalWrite(13, LOW);
   }
   else
@@ -323,6 +390,7 @@ void toggleLogging()
       return;
 
     isLogging = true;
+    stats.reset(VALUE_COUNT);
     digitalWrite(13, HIGH);
   }
 }
@@ -332,7 +400,6 @@ void channelSelect(int channel)
   if (isCalibrating)
   {
     sendDebug("IN USE");
-    delay(500);
     return;
   }
 
@@ -364,45 +431,55 @@ void updateAutoStart()
   if (isLogging)
     return;
 
-  if (!autoStart)
+  if (!settings.autoStart)
     return;
 
-  if (autoStartMode == 0)
+  //Wait for updateBoot() to mount a card instead of failing every loop
+  if (!sdCardInitialized)
+  {
+    autoStartStart = 0;
+    return;
+  }
+
+  if (settings.autoStartMode == 0)
   {
-    if (pvt.gSpeed < autoStartSpeedThreshold)
+    if (pvt.gSpeed < (long)settings.autoStartSpeedThreshold)
       autoStartStart = 0;
     else if (autoStartStart > 0)
     {
-      if (millis() - autoStartStart > autoStartDurationThreshold)
+      if (millis() - autoStartStart > settings.autoStartDurationThreshold)
       {
         sendDebug("Autostarting - M0");
         toggleLogging();
+        autoStartStart = 0; //A failed start waits a full threshold again
       }
     }
     else
       autoStartStart = millis();
-  } else if (autoStartMode == 1)
+  } else if (settings.autoStartMode == 1)
   {
-    if (pvt.fixType < autoStartFixType)
+    if (pvt.fixType < settings.autoStartFixType)
       autoStartStart = 0;
     else if (autoStartStart > 0)
     {
-      if (millis() - autoStartStart > autoStartDurationThreshold)
+      if (millis() - autoStartStart > settings.autoStartDurationThreshold)
       {
         sendDebug("Autostarting - M1");
         toggleLogging();
+        autoStartStart = 0; //A failed start waits a full threshold again
       }
     }
     else
       autoStartStart = millis();
-  } else if (autoStartMode == 2)
+  } else if (settings.autoStartMode == 2)
   { 
     if (autoStartStart > 0)
     {
-      if (millis() - autoStartStart > autoStartDurationThreshold)
+      if (millis() - autoStartStart > settings.autoStartDurationThreshold)
       {
         sendDebug("Autostarting - M2");
         toggleLogging();
+        autoStartStart = 0; //A failed start waits a full threshold again
       }
     }
     else
@@ -412,7 +489,7 @@ void updateAutoStart()
 
 void sendAutoStart()
 {
-  if (autoStart)
+  if (settings.autoStart)
     display.sendValue("autoStartBtn", "Auto ON");
   else
     display.sendValue("autoStartBtn", "Auto OFF");
@@ -420,14 +497,202 @@ void sendAutoStart()
 
 void toggleAutoStart()
 {
-  autoStart = !autoStart;
+  settings.autoStart = !settings.autoStart;
+  config.save();
 
-  if (autoStart)
-    EEPROM.write(AUTOSTART_EEPROM, 0);
-  else
-    EEPROM.write(AUTOSTART_EEPROM, 0xFF);
+  sendAutoStart();
+}
 
+void sendSettings()
+{
+  display.sendValue("autoMode", settings.autoStartMode);
+  display.sendValue("autoFix", settings.autoStartFixType);
+  display.sendValue("autoSpeed", settings.autoStartSpeedThreshold * 36 / 10000); //mm/s -> kph
+  display.sendValue("autoTime", settings.autoStartDurationThreshold);
+  display.sendValue("logInterval", settings.logInterval);
   sendAutoStart();
+  sendTelemetry();
+}
+
+// "set <key> <value>" from the Nextion. Changes take effect right away and
+// are written to EEPROM in the background.
+void applySetting(String command)
+{
+  int split = command.indexOf(' ', setCmd.length());
+
+  if (split < 0)
+  {
+    sendDebug("BAD SET");
+    return;
+  }
+
+  String key = command.substring(setCmd.length(), split);
+  long value = command.substring(split + 1).toInt();
+
+  if (key.equals("autoStart") && value >= 0 && value <= 1)
+    settings.autoStart = value;
+  else if (key.equals("autoMode") && value >= 0 && value <= 2)
+    settings.autoStartMode = value;
+  else if (key.equals("autoFix") && value >= 0 && value <= 5)
+    settings.autoStartFixType = value;
+  else if (key.equals("autoSpeed") && value >= 0 && value <= MAX_AUTO_SPEED)
+    settings.autoStartSpeedThreshold = value * 10000 / 36; //kph -> mm/s
+  else if (key.equals("autoTime") && value >= 0 && value <= MAX_AUTO_TIME)
+    settings.autoStartDurationThreshold = value;
+  else if (key.equals("logInterval") && value >= MIN_LOG_INTERVAL && value <= MAX_LOG_INTERVAL)
+  {
+    settings.logInterval = value;
+
+    //Decimation depends on the log interval
+    if (telemetry.isEnabled())
+      telemetry.begin(settings.logInterval, sizeof(line));
+  }
+  else
+  {
+    sendDebug("BAD SET");
+    return;
+  }
+
+  config.save();
+  sendSettings();
+}
+
+void sendTelemetry()
+{
+  if (telemetry.isEnabled())
+    display.sendValue("telemBtn", "Telem ON");
+  else
+    display.sendValue("telemBtn", "Telem OFF");
+}
+
+void toggleTelemetry()
+{
+  if (telemetry.isEnabled())
+    telemetry.end();
+  else
+    telemetry.begin(settings.logInterval, sizeof(line));
+
+  settings.telemetry = telemetry.isEnabled();
+  config.save();
+
+  sendTelemetry();
+}
+
+bool updateTelemetryStats()
+{
+  TLM_STATS frame;
+  frame.micros = ms;
+  frame.maxLoop = maxLoop > 0xFFFF ? 0xFFFF : maxLoop;
+  frame.logging = isLogging;
+  frame.fixType = pvt.fixType;
+  frame.numSV = pvt.numSV;
+
+  if (!telemetry.sendStats(frame))
+    return false;
+
+  maxLoop = 0;
+  return true;
+}
+
+void updatePosition()
+{
+  //Prefer the high-rate fused solution when the module outputs one
+  if (gps.hasHnr())
+  {
+    HNR_PVT hnr = gps.getLatestHnr();
+
+    line.speed = hnr.gSpeed;
+    line.sAcc = hnr.sAcc;
+    line.lon = hnr.lon;
+    line.lat = hnr.lat;
+    line.alt = hnr.hMSL;
+    line.hAcc = hnr.hAcc;
+    line.vAcc = hnr.vAcc;
+    line.fixType = hnr.gpsFix;
+    return;
+  }
+
+  line.speed = pvt.gSpeed;
+  line.sAcc = pvt.sAcc;
+  line.lon = pvt.lon;
+  line.lat = pvt.lat;
+  line.alt = pvt.alt;
+  line.hAcc = pvt.hAcc;
+  line.vAcc = pvt.vAcc;
+  line.fixType = pvt.fixType;
+
+  //NAV-VELNED is only cm/s, so it replaces PVT's speed only when it is from
+  //a later epoch (it arrives after the PVT of its own epoch) or PVT is stale
+  if (gps.hasVelNed())
+  {
+    NAV_VELNED velned = gps.getLatestVelNed();
+
+    if (!gps.hasPvt() || (long)(velned.iTOW - pvt.iTOW) > 0)
+    {
+      line.speed = velned.gSpd * 10;
+      line.sAcc = velned.sAcc * 10;
+    }
+  }
+}
+
+void updateDerived()
+{
+  if (gps.getPvtTime() != lastPvtTime)
+  {
+    lastPvtTime = gps.getPvtTime();
+    derived.updateVelocity(pvt.iTOW, pvt.velN, pvt.velE, pvt.headMot);
+  }
+
+  for (int i = 0; i < DERIVED_COUNT; i++)
+    line.values[SENSOR_COUNT + i] = derived.get(i);
+}
+
+// The stats page is 3 fields per channel, far more than the Nextion TX
+// buffer holds at 9600 baud. Send one field per loop, and only when it fits
+// in the buffer, so the sample tick never waits on the display.
+// Sends the latest value of one channel per loop after pollValues, only
+// when it fits in the serial buffer so the write never blocks.
+void updateValuesPage()
+{
+  if (valuesCursor < 0 || display.availableForWrite() < VALUES_FIELD_SIZE)
+    return;
+
+  display.sendValue(channelComponentNames[valuesCursor], line.values[valuesCursor]);
+  valuesCursor++;
+
+  if (valuesCursor >= VALUE_COUNT)
+    valuesCursor = -1;
+}
+
+void updateStatsPage()
+{
+  if (statsCursor < 0 || display.availableForWrite() < STATS_FIELD_SIZE)
+    return;
+
+  char name[12];
+  int channel = statsCursor / 3;
+  strcpy(name, channelComponentNames[channel]);
+
+  switch (statsCursor % 3)
+  {
+    case 0:
+      strcat(name, "min");
+      display.sendValue(name, stats.minimum(channel));
+      break;
+    case 1:
+      strcat(name, "max");
+      display.sendValue(name, stats.maximum(channel));
+      break;
+    default:
+      strcat(name, "avg");
+      display.sendValue(name, stats.mean(channel));
+      break;
+  }
+
+  statsCursor++;
+
+  if (statsCursor >= VALUE_COUNT * 3)
+    statsCursor = -1;
 }
 
 void loop()
@@ -441,24 +706,17 @@ void loop()
     pvt = gps.getLatest();
     line.micros = ms;
 
-    line.speed = pvt.gSpeed;
-    line.sAcc = pvt.sAcc;
-    line.lon = pvt.lon;
-    line.lat = pvt.lat;
-    line.alt = pvt.alt;
-    line.hAcc = pvt.hAcc;
-    line.vAcc = pvt.vAcc;
-    line.fixType = pvt.fixType;
+    updatePosition();
 
     int prev = 0;
-    for (int i = 0; i < VALUE_COUNT; i++) {
+    for (int i = 0; i < SENSOR_COUNT; i++) {
       // prev = line.values[i];
 
       if (i < 6)
       {
         line.values[i] = temp[i];
       } else {        
-        line.values[i] = analogRead(inputs[i-6]);
+        line.values[i] = linearize(inputProfiles[i-6], analogRead(inputs[i-6]));
       }
 
       // if (prev != line.values[i])
@@ -467,6 +725,9 @@ void loop()
       // }
     }
 
+    updateDerived();
+    stats.add(line.values);
+
     if (isLogging)
     {
       logFile.write((const uint8_t *)&line, sizeof(line));
@@ -478,21 +739,32 @@ void loop()
       }
     }
 
-    nextLogTime = ms + logInterval;
+    telemetry.sendSample(&line, sizeof(line));
+
+    nextLogTime = ms + settings.logInterval;
   }
 
   if (!isLogging) {
     updateIRTemps();
   }
 
+  updateBoot();
+  updateStatus();
+  updateStatsPage();
+  updateValuesPage();
+  config.update();
+
   if (display.hasCommand())
   {
     String command = display.getCommand();
 
     if (command.equals(pollValuesCmd))
     {
-      for (int i = 0; i < VALUE_COUNT; i++)
-        display.sendValue(channelComponentNames[i], line.values[i]);
+      valuesCursor = 0;
+    }
+    else if (command.equals(pollStatsCmd))
+    {
+      statsCursor = 0;
     }
     else if (command.equals(toggleAutoCmd))
     {
@@ -502,6 +774,22 @@ void loop()
     {
       sendAutoStart();
     }
+    else if (command.equals(toggleTelemetryCmd))
+    {
+      toggleTelemetry();
+    }
+    else if (command.equals(getTelemetryCmd))
+    {
+      sendTelemetry();
+    }
+    else if (command.equals(getSettingsCmd))
+    {
+      sendSettings();
+    }
+    else if (command.startsWith(setCmd))
+    {
+      applySetting(command);
+    }
   }
 
   if (ms > nextInputUpdate)
@@ -540,4 +828,17 @@ void loop()
 
     nextBlink = ms + blinkInterval;
   }  
+
+  if (telemetry.isEnabled())
+  {
+    //Retried every loop until the stats frame fits in the queue
+    if (ms > nextStats && updateTelemetryStats())
+      nextStats = ms + statsInterval;
+
+    telemetry.update();
+
+    unsigned long loopDuration = micros() - ms;
+    if (loopDuration > maxLoop)
+      maxLoop = loopDuration;
+  }
 }
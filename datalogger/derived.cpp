@@ -0,0 +1,189 @@
+#include "derived.h"
+
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+#include <avr/pgmspace.h>
+
+//sin(0..90 degrees) in Q14
+const uint16_t SINE_TABLE[91] PROGMEM = {
+    0, 286, 572, 857, 1143, 1428, 1713, 1997, 2280, 2563,
+    2845, 3126, 3406, 3686, 3964, 4240, 4516, 4790, 5063, 5334,
+    5604, 5872, 6138, 6402, 6664, 6924, 7182, 7438, 7692, 7943,
+    8192, 8438, 8682, 8923, 9162, 9397, 9630, 9860, 10087, 10311,
+    10531, 10749, 10963, 11174, 11381, 11585, 11786, 11982, 12176, 12365,
+    12551, 12733, 12911, 13085, 13255, 13421, 13583, 13741, 13894, 14044,
+    14189, 14330, 14466, 14598, 14726, 14849, 14968, 15082, 15191, 15296,
+    15396, 15491, 15582, 15668, 15749, 15826, 15897, 15964, 16026, 16083,
+    16135, 16182, 16225, 16262, 16294, 16322, 16344, 16362, 16374, 16382,
+    16384,
+};
+
+const long FULL_CIRCLE = 36000000; //headMot scaling is 1e-5 degrees
+const long QUARTER_CIRCLE = FULL_CIRCLE / 4;
+const long DEGREE = 100000;
+const long MAX_ACCELERATION = 65535; //mm/s^2, ~6.7g, keeps the Q14 products in range
+const unsigned long MAX_GPS_GAP = 1000; //ms between solutions before accel is reset
+
+static int16_t sineDegree(uint16_t degree)
+{
+    degree %= 360;
+
+    if (degree <= 90)
+        return pgm_read_word(&SINE_TABLE[degree]);
+    if (degree <= 180)
+        return pgm_read_word(&SINE_TABLE[180 - degree]);
+    if (degree <= 270)
+        return -(int16_t)pgm_read_word(&SINE_TABLE[degree - 180]);
+
+    return -(int16_t)pgm_read_word(&SINE_TABLE[360 - degree]);
+}
+
+//Sine in Q14 of a heading in 1e-5 degrees, interpolated between whole degrees
+int16_t DerivedChannels::sine(long heading)
+{
+    heading %= FULL_CIRCLE;
+    if (heading < 0)
+        heading += FULL_CIRCLE;
+
+    uint16_t degree = heading / DEGREE;
+    uint8_t fraction = (heading % DEGREE) * 256 / DEGREE;
+
+    int16_t a = sineDegree(degree);
+    int16_t b = sineDegree(degree + 1);
+
+    return a + (((long)(b - a) * fraction) >> 8);
+}
+
+static long clampAcceleration(long a)
+{
+    if (a > MAX_ACCELERATION)
+        return MAX_ACCELERATION;
+    if (a < -MAX_ACCELERATION)
+        return -MAX_ACCELERATION;
+    return a;
+}
+
+static int16_t toMilliG(long a)
+{
+    return (a * 1000) / 9807;
+}
+
+void DerivedChannels::reset()
+{
+    hasPrevious = false;
+
+    for (uint8_t i = 0; i < DERIVED_COUNT; i++)
+        values[i] = 0;
+}
+
+// Called once per new navigation solution. Velocities in mm/s, heading of
+// motion in 1e-5 degrees, iTOW in ms.
+void DerivedChannels::updateVelocity(unsigned long iTOW, long velN, long velE, long headMot)
+{
+    unsigned long dt = iTOW - prevITOW;
+
+    if (hasPrevious && dt > 0 && dt <= MAX_GPS_GAP)
+    {
+        long aN = clampAcceleration((velN - prevVelN) * 1000 / (long)dt);
+        long aE = clampAcceleration((velE - prevVelE) * 1000 / (long)dt);
+
+        long s = sine(headMot);
+        long c = sine(headMot + QUARTER_CIRCLE);
+
+        //Project onto the direction of travel and its right-hand normal
+        long longitudinal = ((aN * c) >> 14) + ((aE * s) >> 14);
+        long lateral = ((aE * c) >> 14) - ((aN * s) >> 14);
+
+        values[DERIVED_LON_G] = toMilliG(longitudinal);
+        values[DERIVED_LAT_G] = toMilliG(lateral);
+    }
+    else
+    {
+        values[DERIVED_LON_G] = 0;
+        values[DERIVED_LAT_G] = 0;
+    }
+
+    prevVelN = velN;
+    prevVelE = velE;
+    prevITOW = iTOW;
+    hasPrevious = true;
+}
+
+int16_t DerivedChannels::get(uint8_t channel)
+{
+    if (channel >= DERIVED_COUNT)
+        return 0;
+
+    return values[channel];
+}
+
+//Samples per channel that fit in the 32-bit sums before folding
+const uint16_t STATS_FOLD_INTERVAL = 60000;
+
+void ChannelStats::reset(uint8_t channelCount)
+{
+    channels = channelCount < MAX_STATS_CHANNELS ? channelCount : MAX_STATS_CHANNELS;
+    count = 0;
+    pending = 0;
+
+    for (uint8_t i = 0; i < channels; i++)
+    {
+        mins[i] = 32767;
+        maxs[i] = -32768;
+        sums[i] = 0;
+        totals[i] = 0;
+    }
+}
+
+void ChannelStats::fold()
+{
+    for (uint8_t i = 0; i < channels; i++)
+    {
+        totals[i] += sums[i];
+        sums[i] = 0;
+    }
+
+    pending = 0;
+}
+
+void ChannelStats::add(const uint16_t values[])
+{
+    for (uint8_t i = 0; i < channels; i++)
+    {
+        int16_t value = (int16_t)values[i];
+
+        if (value < mins[i])
+            mins[i] = value;
+        if (value > maxs[i])
+            maxs[i] = value;
+
+        sums[i] += value;
+    }
+
+    count++;
+
+    if (++pending >= STATS_FOLD_INTERVAL)
+        fold();
+}
+
+int16_t ChannelStats::minimum(uint8_t channel)
+{
+    return count > 0 && channel < channels ? mins[channel] : 0;
+}
+
+int16_t ChannelStats::maximum(uint8_t channel)
+{
+    return count > 0 && channel < channels ? maxs[channel] : 0;
+}
+
+int16_t ChannelStats::mean(uint8_t channel)
+{
+    if (count == 0 || channel >= channels)
+        return 0;
+
+    return (totals[channel] + sums[channel]) / (long)count;
+}
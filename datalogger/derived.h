@@ -0,0 +1,54 @@
+#ifndef DERIVED_H
+#define DERIVED_H
+
+#include <inttypes.h>
+
+// Channels computed on the logger, appended after the sensor values.
+// Everything is integer/fixed-point so the AVR never pulls in soft-float.
+
+const uint8_t DERIVED_COUNT = 2;
+const uint8_t DERIVED_LON_G = 0; //Longitudinal acceleration, milli-g, forward positive
+const uint8_t DERIVED_LAT_G = 1; //Lateral acceleration, milli-g, right positive
+
+const uint8_t MAX_STATS_CHANNELS = 16;
+
+class DerivedChannels {
+    long prevVelN = 0;
+    long prevVelE = 0;
+    unsigned long prevITOW = 0;
+    bool hasPrevious = false;
+
+    int16_t values[DERIVED_COUNT] = {0, 0};
+
+    private:
+        int16_t sine(long heading);
+
+    public:
+        void reset();
+        void updateVelocity(unsigned long iTOW, long velN, long velE, long headMot);
+        int16_t get(uint8_t channel);
+};
+
+// Session min/max/mean per logged channel, O(1) per sample.
+// Values are treated as signed 16-bit (temperatures and g can be negative).
+class ChannelStats {
+    int16_t mins[MAX_STATS_CHANNELS];
+    int16_t maxs[MAX_STATS_CHANNELS];
+    int32_t sums[MAX_STATS_CHANNELS]; //Recent samples, folded into totals before they can overflow
+    int64_t totals[MAX_STATS_CHANNELS];
+    uint16_t pending = 0;
+    uint8_t channels = 0;
+    unsigned long count = 0;
+
+    private:
+        void fold();
+
+    public:
+        void reset(uint8_t channelCount);
+        void add(const uint16_t values[]);
+        int16_t minimum(uint8_t channel);
+        int16_t maximum(uint8_t channel);
+        int16_t mean(uint8_t channel);
+};
+
+#endif
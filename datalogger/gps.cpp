@@ -12,75 +12,113 @@ void Gps::setup()
 {
     GPS.begin(38400);
 
-    process();
+    update();
 };
 
-void Gps::calcChecksum(unsigned char* CK)
+bool Gps::store(void* target, uint8_t size, unsigned long& arrival)
 {
-    memset(CK, 0, 2);
-    for (int i = 0; i < (int)sizeof(NAV_PVT); i++) {
-        CK[0] += ((unsigned char*)(&pvtBuffer))[i];
-        CK[1] += CK[0];
-    }
+    //Messages start at the class byte, right after the header
+    if ( parser.payloadLength() != size )
+        return false;
+
+    memcpy(target, parser.payload(), size);
+    arrival = micros();
+
+    //0 means "never arrived"
+    if ( arrival == 0 )
+        arrival = 1;
+
+    return true;
 };
 
-bool Gps::process()
+void Gps::dispatch()
 {
-    static int fpos = 0;
-    static unsigned char checksum[2];
-    const int payloadSize = sizeof(NAV_PVT);
+    const uint8_t* frame = parser.payload();
+    uint8_t cls = frame[0];
+    uint8_t id = frame[1];
 
-    while ( GPS.available() ) {
-        byte c = GPS.read();
-        if ( fpos < 2 ) {
-            if ( c == UBX_HEADER[fpos] )
-                fpos++;
-            else
-                fpos = 0;
-        }
-        else {
-            if ( (fpos-2) < payloadSize )
-            {
-                ((unsigned char*)(&pvtBuffer))[fpos-2] = c;
-            }
-
-            fpos++;
-
-            if ( fpos == (payloadSize+2) ) 
-            {
-                calcChecksum(checksum);
-            }
-            else if ( fpos == (payloadSize+3) ) 
-            {
-                if ( c != checksum[0] )
-                    fpos = 0;
-            }
-            else if ( fpos == (payloadSize+4) ) 
-            {
-                fpos = 0;
-                if ( c == checksum[1] ) {
-                    return true;
-                }
-            }
-            else if ( fpos > (payloadSize+4) ) {
-                fpos = 0;
-            }
-        }
+    if ( cls == NAV_CLASS && id == NAV_PVT_ID )
+        store(&latestPVT, sizeof(NAV_PVT), pvtTime);
+    else if ( cls == NAV_CLASS && id == NAV_VELNED_ID )
+        store(&latestVELNED, sizeof(NAV_VELNED), velnedTime);
+    else if ( cls == HNR_CLASS && id == HNR_PVT_ID )
+        store(&latestHNR, sizeof(HNR_PVT), hnrTime);
+    else if ( cls == ACK_CLASS && (id == ACK_ACK_ID || id == ACK_NAK_ID) )
+    {
+        if ( store(&latestAck, sizeof(ACK_ACK), ackTime) )
+            latestAckIsNak = id == ACK_NAK_ID;
     }
-    return false;
 };
 
 void Gps::update()
 {
-    if (process())
-        latestPVT = pvtBuffer;
+    while ( GPS.available() ) {
+        if ( parser.push(GPS.read()) == FRAME_OK )
+            dispatch();
+    }
 };
 
+bool Gps::isFresh(unsigned long arrival)
+{
+    return arrival != 0 && micros() - arrival < GPS_STALE_TIMEOUT;
+}
+
 NAV_PVT Gps::getLatest()
 {
     return latestPVT;
 }
 
+NAV_VELNED Gps::getLatestVelNed()
+{
+    return latestVELNED;
+}
+
+HNR_PVT Gps::getLatestHnr()
+{
+    return latestHNR;
+}
+
+ACK_ACK Gps::getLatestAck(bool& isNak)
+{
+    isNak = latestAckIsNak;
+    return latestAck;
+}
+
+unsigned long Gps::getPvtTime()
+{
+    return pvtTime;
+}
+
+unsigned long Gps::getVelNedTime()
+{
+    return velnedTime;
+}
+
+unsigned long Gps::getHnrTime()
+{
+    return hnrTime;
+}
+
+unsigned long Gps::getAckTime()
+{
+    return ackTime;
+}
+
+bool Gps::hasPvt()
+{
+    return isFresh(pvtTime);
+}
+
+bool Gps::hasVelNed()
+{
+    return isFresh(velnedTime);
+}
+
+bool Gps::hasHnr()
+{
+    return isFresh(hnrTime);
+}
+
 bool Gps::has3DFix()
 {
     //Fixtype 3 = Full 3D fix
@@ -2,6 +2,7 @@
 #define GPS_H
 
 #include "UBX.h"
+#include "framing.h"
 
 #if defined(__AVR_ATmega2560__)
   #define GPS Serial1
@@ -9,20 +10,79 @@
   #define GPS Serial
 #endif
 
-class Gps 
+//A message is considered present if it arrived within this many micros
+const unsigned long GPS_STALE_TIMEOUT = 1000000;
+
+//Longer frames are treated as a false header instead of being skipped.
+//NAV-SAT with 64 satellites, the longest message we expect, is 776 bytes.
+const uint16_t GPS_MAX_SKIP_PAYLOAD = 800;
+
+// Frames Gps has a handler for are buffered and checksummed. Other frames
+// from known UBX classes with a plausible length are skipped without
+// buffering; anything else is treated as a false header.
+struct GpsMessageFilter {
+    static FrameFilter check(const uint8_t* buffer)
+    {
+        uint8_t cls = buffer[2];
+        uint8_t id = buffer[3];
+        uint16_t payload = buffer[4] | (buffer[5] << 8);
+
+        if ((cls == NAV_CLASS && (id == NAV_PVT_ID || id == NAV_VELNED_ID))
+            || (cls == HNR_CLASS && id == HNR_PVT_ID)
+            || cls == ACK_CLASS)
+            return FILTER_ACCEPT;
+
+        switch (cls)
+        {
+            case 0x01: case 0x02: case 0x04: case 0x06: case 0x09: case 0x0A:
+            case 0x0B: case 0x0D: case 0x10: case 0x13: case 0x21: case 0x27:
+            case 0x28:
+                return payload <= GPS_MAX_SKIP_PAYLOAD ? FILTER_SKIP : FILTER_REJECT;
+            default:
+                return FILTER_REJECT;
+        }
+    }
+};
+
+typedef FrameParser<FixedHeader<0xB5, 0x62>, UbxLength, FletcherChecksum<2>, NoTerminator, 100, GpsMessageFilter> GpsParser;
+
+class Gps
 {
-    NAV_PVT pvtBuffer, latestPVT;
+    NAV_PVT latestPVT;
+    NAV_VELNED latestVELNED;
+    HNR_PVT latestHNR;
+    ACK_ACK latestAck;
+    bool latestAckIsNak = false;
+
+    //micros() when each message last arrived, 0 if never
+    unsigned long pvtTime = 0;
+    unsigned long velnedTime = 0;
+    unsigned long hnrTime = 0;
+    unsigned long ackTime = 0;
+
+    GpsParser parser;
 
     private:
-        void calcChecksum (unsigned char* CK);
-        bool process();
+        void dispatch();
+        bool store(void* target, uint8_t size, unsigned long& arrival);
+        bool isFresh(unsigned long arrival);
 
     public:
         void setup();
         void update();
         NAV_PVT getLatest();
+        NAV_VELNED getLatestVelNed();
+        HNR_PVT getLatestHnr();
+        ACK_ACK getLatestAck(bool& isNak);
+        unsigned long getPvtTime();
+        unsigned long getVelNedTime();
+        unsigned long getHnrTime();
+        unsigned long getAckTime();
+        bool hasPvt();
+        bool hasVelNed();
+        bool hasHnr();
         bool has3DFix();
         bool hasTimeFix();
 };
 
-#endif
\ No newline at end of file
+#endif
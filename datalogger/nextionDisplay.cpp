@@ -25,7 +25,7 @@ void NextionDisplay::sendCommand(char command[])
     sendEOL();
 }
 
-void NextionDisplay::sendValue(char componentName[], char value[])
+void NextionDisplay::sendValue(char componentName[], const char value[])
 {
     Nextion.print(componentName);
     Nextion.print(".txt=\"");
@@ -42,17 +42,22 @@ void NextionDisplay::sendValue(char componentName[], int value)
     sendEOL();
 }
 
-void NextionDisplay::debug(char text[])
+int NextionDisplay::availableForWrite()
+{
+    return Nextion.availableForWrite();
+}
+
+void NextionDisplay::debug(const char text[])
 {
     sendValue("debug", text);
 }
 
-void NextionDisplay::extractCommand(int length)
+void NextionDisplay::extractCommand(const uint8_t* data, uint8_t length)
 {
     char commandBuffer[length + 1];
 
-    for(int i = 1; i < length+2; i++)
-        commandBuffer[i- 1] = buffer[i];
+    memcpy(commandBuffer, data, length);
+    commandBuffer[length] = 0x00;
 
     command = String(commandBuffer);
 }
@@ -61,41 +66,17 @@ bool NextionDisplay::hasCommand()
 {
     while(Nextion.available())
     {
-        byte c = Nextion.read();
-        buffer[bufPos] = c;
-
-        if (c == 0xFF)
-        {
-            eolCounter++;
-
-            if (eolCounter >= 3)
-            {
-                buffer[bufPos - 0] = 0x00;
-                buffer[bufPos - 1] = 0x00;
-                buffer[bufPos - 2] = 0x00;
-
-                if (buffer[0] == 'p')
-                {
-                    extractCommand(bufPos-3);
-                    
-                    bufPos = 0;
-                    eolCounter = 0;
-                    return true;
-                }
-            }
-        }
-        else
-        {
-            eolCounter = 0;
-        }
+        if (parser.push(Nextion.read()) != FRAME_OK)
+            continue;
 
-        bufPos++;
+        //String data from the display is returned as 0x70 ('p') + text
+        const uint8_t* frame = parser.payload();
+        uint8_t length = parser.payloadLength();
 
-        if (bufPos >= 40)
+        if (length > 0 && frame[0] == 'p')
         {
-            debug("HICK");
-            bufPos = 0;
-            eolCounter = 0;
+            extractCommand(frame + 1, length - 1);
+            return true;
         }
     }
 
@@ -3,6 +3,7 @@
 
 #include <inttypes.h>
 #include <WString.h>
+#include "framing.h"
 
 #if defined(__AVR_ATmega2560__)
 #define Nextion Serial3
@@ -14,16 +15,15 @@ class NextionDisplay {
     private:
         void sendEOL();
         String command;
-        char buffer[40];
-        int bufPos = 0;
-        int eolCounter = 0;
-        void extractCommand(int length);
+        NextionParser parser;
+        void extractCommand(const uint8_t* data, uint8_t length);
     public:
         void setup();
-        void debug(char text[]);
+        void debug(const char text[]);
         void sendCommand(char command[]);
-        void sendValue(char componentName[], char value[]);
+        void sendValue(char componentName[], const char value[]);
         void sendValue(char componentName[], int value);
+        int availableForWrite();
         bool hasCommand();
         String getCommand();
 };
@@ -0,0 +1,28 @@
+#include "sensors.h"
+
+// Looks a reading up in a profile table, interpolating between the two
+// nearest points. A null table passes the count through.
+int16_t linearize(const int16_t* table, uint16_t count)
+{
+    if (!table)
+        return count;
+
+    uint16_t first = pgm_read_word(&table[0]);
+    uint16_t last = pgm_read_word(&table[1]);
+
+    if (count < first)
+        count = first;
+    else if (count > last)
+        count = last;
+
+    table += SENSOR_TABLE_HEADER;
+
+    uint8_t index = count >> SENSOR_TABLE_SHIFT;
+    uint8_t fraction = count & (SENSOR_TABLE_STEP - 1);
+
+    int16_t a = pgm_read_word(&table[index]);
+    int16_t b = pgm_read_word(&table[index + 1]);
+
+    //Rounded, so a knee at a count between table points is hit exactly
+    return a + (((long)(b - a) * fraction + SENSOR_TABLE_STEP / 2) >> SENSOR_TABLE_SHIFT);
+}
@@ -0,0 +1,171 @@
+#ifndef SENSORS_H
+#define SENSORS_H
+
+#include <inttypes.h>
+
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#else
+//Host builds, see tools/sensorcheck.cpp
+#define PROGMEM
+#define pgm_read_word(address) (*(const uint16_t*)(address))
+#endif
+
+// Transfer functions for the analog inputs. Each profile is a curve that is
+// evaluated by the compiler into a PROGMEM table of SENSOR_TABLE_SIZE points,
+// one every SENSOR_TABLE_STEP counts of the 10-bit ADC. At runtime a reading
+// costs four pgm_read_word and an integer interpolation; no float code ends up
+// on the AVR.
+//
+// A table starts with the first and last count the curve is defined for;
+// readings are clamped to them before interpolating, so a knee between two
+// table points (e.g. where a sender's output range starts) stays sharp.
+//
+// Units are chosen per profile so they fit the int16 log values:
+// temperatures in 0.1 C, positions in 0.1 %, pressures in whatever the
+// FULL_SCALE of the profile is given in (e.g. mbar).
+
+const uint8_t SENSOR_TABLE_SHIFT = 5;
+const uint16_t SENSOR_TABLE_STEP = 1 << SENSOR_TABLE_SHIFT;
+const uint8_t SENSOR_TABLE_SIZE = 1024 / SENSOR_TABLE_STEP + 1;
+const uint8_t SENSOR_TABLE_HEADER = 2; //First and last count
+
+namespace sensormath {
+
+constexpr double LN2 = 0.6931471805599453;
+
+constexpr double clamp(double x, double low, double high)
+{
+    return x < low ? low : (x > high ? high : x);
+}
+
+constexpr int16_t round16(double x)
+{
+    return (int16_t)(x < 0 ? x - 0.5 : x + 0.5);
+}
+
+constexpr int16_t saturate16(double x)
+{
+    return round16(clamp(x, -32768, 32767));
+}
+
+//2 * atanh(y) = ln((1 + y) / (1 - y)), converges fast for |y| <= 1/3
+constexpr double atanhSeries(double y, double y2, double term, uint8_t n)
+{
+    return n >= 24 ? 0 : term / (2 * n + 1) + atanhSeries(y, y2, term * y2, n + 1);
+}
+
+//Reduces to [1, 2] first so the series stays short
+constexpr double ln(double x)
+{
+    return x > 2 ? ln(x / 2) + LN2
+        : x < 1 ? ln(x * 2) - LN2
+        : 2 * atanhSeries((x - 1) / (x + 1), ((x - 1) / (x + 1)) * ((x - 1) / (x + 1)), (x - 1) / (x + 1), 0);
+}
+
+constexpr double newton(double x, double guess, uint8_t n)
+{
+    return n == 0 ? guess : newton(x, (guess + x / guess) / 2, n - 1);
+}
+
+constexpr double sqrt(double x)
+{
+    return x <= 0 ? 0 : newton(x, x > 1 ? x : 1, 32);
+}
+
+//ADC reading as a fraction of the reference, kept off the rails
+constexpr double ratio(uint16_t count)
+{
+    return clamp(count / 1024.0, 0.5 / 1024, 1023.5 / 1024);
+}
+
+}
+
+// Straight line through two (count, value) points, flat outside them.
+// Covers ratiometric pressure senders: a 0.5-4.5 V, 0-10 bar part is
+// LinearCurve<102, 0, 922, 10000> in mbar. The table holds the extended
+// line; clamping the count to the two points gives the flat ends.
+template <uint16_t COUNT_LOW, int16_t VALUE_LOW, uint16_t COUNT_HIGH, int16_t VALUE_HIGH>
+struct LinearCurve {
+    static const uint16_t FIRST_COUNT = COUNT_LOW;
+    static const uint16_t LAST_COUNT = COUNT_HIGH;
+
+    static constexpr int16_t at(uint16_t count)
+    {
+        return sensormath::saturate16(
+            VALUE_LOW + (double)(VALUE_HIGH - VALUE_LOW) * ((double)count - COUNT_LOW) / (COUNT_HIGH - COUNT_LOW));
+    }
+};
+
+// NTC thermistor to ground with a pull-up to the ADC reference, beta model.
+// Output in 0.1 C.
+template <uint32_t R25, uint16_t BETA, uint32_t PULL_UP>
+struct NtcCurve {
+    static const uint16_t FIRST_COUNT = 0;
+    static const uint16_t LAST_COUNT = 1023;
+
+    static constexpr double resistance(uint16_t count)
+    {
+        return PULL_UP * sensormath::ratio(count) / (1 - sensormath::ratio(count));
+    }
+
+    static constexpr double celsius(double r)
+    {
+        return 1 / (1 / 298.15 + sensormath::ln(r / R25) / BETA) - 273.15;
+    }
+
+    static constexpr int16_t at(uint16_t count)
+    {
+        return sensormath::round16(sensormath::clamp(celsius(resistance(count)), -55, 300) * 10);
+    }
+};
+
+// Potentiometer across the reference whose wiper is loaded by LOAD ohms to
+// ground, which bends the reading down in the middle of the travel.
+// Output in 0.1 % of travel.
+template <uint32_t POT, uint32_t LOAD>
+struct LoadedPotCurve {
+    static const uint16_t FIRST_COUNT = 0;
+    static const uint16_t LAST_COUNT = 1023;
+
+    //Solves r = (x*P || L) / ((1 - x)*P + x*P || L) for x, with a = L / P:
+    //r x^2 + (a - r) x - r a = 0
+    static constexpr double travel(double r, double a)
+    {
+        return (r - a + sensormath::sqrt((a - r) * (a - r) + 4 * r * r * a)) / (2 * r);
+    }
+
+    static constexpr int16_t at(uint16_t count)
+    {
+        return sensormath::round16(sensormath::clamp(travel(sensormath::ratio(count), (double)LOAD / POT), 0, 1) * 1000);
+    }
+};
+
+template <uint8_t... I> struct IndexList {};
+template <uint8_t N, uint8_t... I> struct MakeIndices : MakeIndices<N - 1, N - 1, I...> {};
+template <uint8_t... I> struct MakeIndices<0, I...> { typedef IndexList<I...> type; };
+
+template <typename Curve, typename Indices> struct SensorTableOf;
+
+template <typename Curve, uint8_t... I>
+struct SensorTableOf<Curve, IndexList<I...> > {
+    static constexpr int16_t values[SENSOR_TABLE_HEADER + SENSOR_TABLE_SIZE] PROGMEM = {
+        Curve::FIRST_COUNT, Curve::LAST_COUNT, Curve::at(I * SENSOR_TABLE_STEP)...
+    };
+};
+
+template <typename Curve, uint8_t... I>
+constexpr int16_t SensorTableOf<Curve, IndexList<I...> >::values[SENSOR_TABLE_HEADER + SENSOR_TABLE_SIZE] PROGMEM;
+
+template <typename Curve>
+using SensorTable = SensorTableOf<Curve, typename MakeIndices<SENSOR_TABLE_SIZE>::type>;
+
+// Profiles for the senders we run. Pass SENSOR_RAW to log plain counts.
+#define SENSOR_RAW ((const int16_t*)0)
+#define SENSOR_OIL_PRESSURE_10BAR (SensorTable<LinearCurve<102, 0, 922, 10000> >::values) //mbar
+#define SENSOR_NTC_10K_3950 (SensorTable<NtcCurve<10000, 3950, 2200> >::values) //0.1 C, 2k2 pull-up
+#define SENSOR_THROTTLE_5K (SensorTable<LoadedPotCurve<5000, 47000> >::values) //0.1 %, 47k input load
+
+int16_t linearize(const int16_t* table, uint16_t count);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include "configstore.h"
+
+// Persistent datalogger settings, editable from the Nextion with
+// "set <key> <value>". Only ever append fields (see configstore.h) and bump
+// SETTINGS_VERSION when the meaning of a stored field changes.
+struct LoggerSettings {
+    uint8_t         autoStart = 1;
+    uint8_t         autoStartMode = 1; //0 = speed, 1 = fixType, 2 = Power (always log)
+    uint8_t         autoStartFixType = 3; //3 = Full 3D
+    uint8_t         telemetry = 0; //Enable telemetry at boot
+    uint32_t        autoStartSpeedThreshold = 30 * 0.277 * 1000; // 30kph -> m/s -> mm/s
+    uint32_t        autoStartDurationThreshold = 2000; //ms
+    uint32_t        logInterval = 4000; //us
+};
+
+const uint8_t SETTINGS_VERSION = 1;
+const uint16_t SETTINGS_EEPROM = 16; //Below is the single autostart byte of older firmware
+const uint8_t SETTINGS_SLOTS = 8;
+const uint8_t SETTINGS_SLOT_SIZE = 32;
+
+//Limits for "set"; the Nextion fields take a 16 bit int
+const long MAX_AUTO_SPEED = 300; //kph
+const long MAX_AUTO_TIME = 30000; //ms
+const long MIN_LOG_INTERVAL = 1000; //us
+const long MAX_LOG_INTERVAL = 30000; //us
+
+typedef ConfigStore<LoggerSettings, SETTINGS_VERSION, SETTINGS_EEPROM, SETTINGS_SLOTS, SETTINGS_SLOT_SIZE> SettingsStore;
+
+#endif
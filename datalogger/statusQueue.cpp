@@ -0,0 +1,32 @@
+#include "statusQueue.h"
+
+#include <string.h>
+
+void StatusQueue::push(const char text[])
+{
+    if (count == STATUS_QUEUE_SIZE)
+    {
+        head = (head + 1) % STATUS_QUEUE_SIZE;
+        count--;
+    }
+
+    char* slot = messages[(head + count) % STATUS_QUEUE_SIZE];
+    strncpy(slot, text, STATUS_LENGTH - 1);
+    slot[STATUS_LENGTH - 1] = 0x00;
+    count++;
+}
+
+// Returns the message to show now (millis()), or 0 while the previous one
+// is still being held or nothing is queued. The returned text is valid
+// until the next push.
+const char* StatusQueue::next(unsigned long now)
+{
+    if (count == 0 || (long)(now - nextTime) < 0)
+        return 0;
+
+    const char* text = messages[head];
+    head = (head + 1) % STATUS_QUEUE_SIZE;
+    count--;
+    nextTime = now + STATUS_HOLD_TIME;
+    return text;
+}
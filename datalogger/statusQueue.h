@@ -0,0 +1,24 @@
+#ifndef STATUSQUEUE_H
+#define STATUSQUEUE_H
+
+#include <inttypes.h>
+
+const uint8_t STATUS_QUEUE_SIZE = 8;
+const uint8_t STATUS_LENGTH = 24;
+const unsigned long STATUS_HOLD_TIME = 500; //ms each message stays readable on the display
+
+// Messages for the Nextion debug line. Instead of delay()ing after each
+// message so it can be read, messages are queued and released one per
+// STATUS_HOLD_TIME. When the queue is full the oldest message is dropped.
+class StatusQueue {
+    char messages[STATUS_QUEUE_SIZE][STATUS_LENGTH];
+    uint8_t head = 0;
+    uint8_t count = 0;
+    unsigned long nextTime = 0;
+
+    public:
+        void push(const char text[]);
+        const char* next(unsigned long now);
+};
+
+#endif
@@ -0,0 +1,165 @@
+#include "telemetry.h"
+
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+void Telemetry::begin(unsigned long logInterval, uint8_t sampleSize)
+{
+    if (!TELEMETRY_AVAILABLE)
+        return;
+
+    Serial.flush();
+    Serial.begin(TELEMETRY_BAUD);
+
+    //Keep a quarter of the link free for stats and text frames
+    unsigned long budget = TELEMETRY_BAUD / 10 * 3 / 4;
+    unsigned long needed = (1000000 / logInterval) * (sampleSize + 6);
+    decimation = (needed + budget - 1) / budget;
+
+    if (decimation < 1)
+        decimation = 1;
+
+    frameLength = framePos = 0;
+    pendingHead = pendingCount = 0;
+    tick = sent = dropped = 0;
+    enabled = true;
+}
+
+void Telemetry::end()
+{
+    if (!enabled)
+        return;
+
+    Serial.flush();
+    Serial.begin(9600);
+    enabled = false;
+}
+
+bool Telemetry::isEnabled()
+{
+    return enabled;
+}
+
+void Telemetry::encode(const uint8_t* source, uint8_t length)
+{
+    uint8_t codeIndex = 0;
+    uint8_t code = 1;
+    uint8_t out = 1;
+
+    for (uint8_t i = 0; i < length; i++)
+    {
+        if (source[i] == 0x00)
+        {
+            frame[codeIndex] = code;
+            codeIndex = out++;
+            code = 1;
+        }
+        else
+        {
+            frame[out++] = source[i];
+            code++;
+        }
+    }
+
+    frame[codeIndex] = code;
+    frame[out++] = 0x00;
+
+    frameLength = out;
+    framePos = 0;
+}
+
+// Writes [id][sequence][payload][ck_a][ck_b] to target, returns its length.
+uint8_t Telemetry::build(uint8_t* target, unsigned char id, const void* payload, uint8_t length)
+{
+    target[0] = id;
+    target[1] = sequence++;
+    memcpy(target + 2, payload, length);
+
+    unsigned char ckA = 0, ckB = 0;
+    for (uint8_t i = 0; i < length + 2; i++)
+    {
+        ckA += target[i];
+        ckB += ckA;
+    }
+
+    target[length + 2] = ckA;
+    target[length + 3] = ckB;
+
+    return length + 4;
+}
+
+// Queues a stats or text frame. Fails only when the queue is full.
+bool Telemetry::queue(unsigned char id, const void* payload, uint8_t length)
+{
+    if (!enabled || pendingCount == TLM_QUEUE_SIZE || length > TLM_MAX_PAYLOAD)
+        return false;
+
+    uint8_t slot = (pendingHead + pendingCount) % TLM_QUEUE_SIZE;
+    pendingLength[slot] = build(pending[slot], id, payload, length);
+    pendingCount++;
+    return true;
+}
+
+void Telemetry::sendSample(const void* sample, uint8_t length)
+{
+    if (!enabled)
+        return;
+
+    if (++tick < decimation)
+        return;
+
+    tick = 0;
+
+    //Queued frames go first, they are rare and already waited
+    if (framePos < frameLength || pendingCount > 0 || length > TLM_MAX_PAYLOAD)
+    {
+        dropped++;
+        return;
+    }
+
+    //Frames stay below 254 bytes, so COBS never needs a split block
+    encode(raw, build(raw, TLM_SAMPLE_ID, sample, length));
+    sent++;
+}
+
+bool Telemetry::sendStats(TLM_STATS& stats)
+{
+    stats.sent = sent;
+    stats.dropped = dropped;
+    stats.decimation = decimation;
+
+    if (!queue(TLM_STATS_ID, &stats, sizeof(stats)))
+        return false;
+
+    sent = dropped = 0;
+    return true;
+}
+
+bool Telemetry::sendText(const char text[])
+{
+    return queue(TLM_TEXT_ID, text, strnlen(text, TLM_MAX_PAYLOAD));
+}
+
+void Telemetry::update()
+{
+    if (framePos >= frameLength)
+    {
+        if (pendingCount == 0)
+            return;
+
+        encode(pending[pendingHead], pendingLength[pendingHead]);
+        pendingHead = (pendingHead + 1) % TLM_QUEUE_SIZE;
+        pendingCount--;
+    }
+
+    int room = Serial.availableForWrite();
+
+    while (room > 0 && framePos < frameLength)
+    {
+        Serial.write(frame[framePos++]);
+        room--;
+    }
+}
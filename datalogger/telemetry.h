@@ -0,0 +1,73 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <inttypes.h>
+
+// Binary live telemetry over the debug serial port.
+//
+// Every frame is [id][sequence][payload][ck_a][ck_b] (Fletcher checksum as
+// used by UBX, over id..payload), COBS encoded and terminated by 0x00.
+// Frames are pumped out of a single buffer a few bytes at a time so the log
+// tick never waits on the UART. Stats and text frames wait in a small queue
+// and go out before the next sample; samples are dropped while the link is
+// busy.
+//
+// Boards without Serial1 have the GPS on Serial, so telemetry stays off.
+
+#if defined(__AVR_ATmega2560__)
+  #define TELEMETRY_AVAILABLE 1
+#else
+  #define TELEMETRY_AVAILABLE 0
+#endif
+
+const unsigned long TELEMETRY_BAUD = 250000;
+const uint8_t TLM_MAX_PAYLOAD = 80;
+const uint8_t TLM_QUEUE_SIZE = 3; //Stats and text frames waiting for the link
+
+const unsigned char TLM_SAMPLE_ID = 0x01; //Payload: LogLine as written to the log
+const unsigned char TLM_STATS_ID = 0x02;
+const unsigned char TLM_TEXT_ID = 0x03;
+
+struct TLM_STATS {
+    uint32_t micros;
+    uint16_t sent; //Samples sent since the previous stats frame
+    uint16_t dropped; //Samples skipped because the link was busy
+    uint16_t decimation; //Log ticks per telemetry sample
+    uint16_t maxLoop; //Longest loop() in microseconds
+    uint8_t  logging;
+    uint8_t  fixType;
+    uint8_t  numSV;
+};
+
+class Telemetry {
+    uint8_t raw[TLM_MAX_PAYLOAD + 4];
+    uint8_t pending[TLM_QUEUE_SIZE][TLM_MAX_PAYLOAD + 4];
+    uint8_t pendingLength[TLM_QUEUE_SIZE];
+    uint8_t pendingHead = 0;
+    uint8_t pendingCount = 0;
+    uint8_t frame[TLM_MAX_PAYLOAD + 8];
+    uint8_t frameLength = 0;
+    uint8_t framePos = 0;
+    uint8_t sequence = 0;
+    uint16_t decimation = 1;
+    uint16_t tick = 0;
+    uint16_t sent = 0;
+    uint16_t dropped = 0;
+    bool enabled = false;
+
+    private:
+        uint8_t build(uint8_t* target, unsigned char id, const void* payload, uint8_t length);
+        bool queue(unsigned char id, const void* payload, uint8_t length);
+        void encode(const uint8_t* source, uint8_t length);
+
+    public:
+        void begin(unsigned long logInterval, uint8_t sampleSize);
+        void end();
+        bool isEnabled();
+        void sendSample(const void* sample, uint8_t length);
+        bool sendStats(TLM_STATS& stats);
+        bool sendText(const char text[]);
+        void update();
+};
+
+#endif
@@ -0,0 +1,190 @@
+#ifndef CONFIGSTORE_H
+#define CONFIGSTORE_H
+
+// Versioned, CRC-checked settings record kept in RAM and persisted to EEPROM.
+// Shared by the datalogger and the NanoGpu; keep both copies identical.
+//
+// The EEPROM area at BASE is split into SLOTS slots of SLOT_SIZE bytes, each
+// holding [sequence u16][version u8][length u8][record][crc16]. load() takes
+// the valid slot with the newest sequence. save() targets the next slot
+// round-robin, which spreads the wear over all slots and leaves the previous
+// record intact if power is lost mid-write. The write runs in the
+// background: update() commits one byte whenever the EEPROM is idle, so the
+// ~3.3 ms a byte takes never stalls the caller.
+//
+// Records may only grow by appending fields. A shorter stored record is
+// copied over the defaults, which leaves the new fields at their default.
+// Any other change to the layout needs a new VERSION; a record stored under
+// another version is never copied, the caller decides how to migrate it.
+
+#include <inttypes.h>
+#include <string.h>
+#include <avr/eeprom.h>
+
+const uint8_t CONFIG_HEADER_SIZE = 4;
+const uint8_t CONFIG_OVERHEAD = CONFIG_HEADER_SIZE + 2;
+
+//CRC-16/CCITT-FALSE
+inline uint16_t configCrc(uint16_t crc, uint8_t data)
+{
+    crc ^= (uint16_t)data << 8;
+
+    for (uint8_t i = 0; i < 8; i++)
+        crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+
+    return crc;
+}
+
+template <typename Record, uint8_t VERSION, uint16_t BASE, uint8_t SLOTS, uint8_t SLOT_SIZE>
+class ConfigStore {
+    static_assert(VERSION > 0, "Version 0 means no stored record");
+    static_assert(sizeof(Record) + CONFIG_OVERHEAD <= SLOT_SIZE, "Record does not fit in a slot");
+    static_assert(SLOT_SIZE < 0xFF, "Erased slots must not pass the length check");
+
+    uint8_t pending[sizeof(Record) + CONFIG_OVERHEAD]; //Snapshot being written
+    uint8_t written = 0;
+    bool writing = false;
+    uint8_t newest = SLOTS - 1; //Slot holding the record last loaded or written
+    uint8_t target = 0;
+    uint16_t sequence = 0;
+
+    private:
+        uint16_t address(uint8_t slot, uint8_t offset) { return BASE + slot * SLOT_SIZE + offset; }
+        bool readSlot(uint8_t slot, uint16_t& slotSequence, uint8_t& version, uint8_t& length);
+
+    public:
+        Record data;
+
+        uint8_t load();
+        uint8_t read(Record& record);
+        void save() { save(data); }
+        void save(const Record& record);
+        void update();
+        bool isBusy() { return writing; }
+};
+
+// Checks a slot's length and CRC, returning its header.
+template <typename Record, uint8_t VERSION, uint16_t BASE, uint8_t SLOTS, uint8_t SLOT_SIZE>
+bool ConfigStore<Record, VERSION, BASE, SLOTS, SLOT_SIZE>::readSlot(uint8_t slot, uint16_t& slotSequence, uint8_t& version, uint8_t& length)
+{
+    uint8_t header[CONFIG_HEADER_SIZE];
+    eeprom_read_block(header, (const void*)address(slot, 0), CONFIG_HEADER_SIZE);
+
+    slotSequence = header[0] | (header[1] << 8);
+    version = header[2];
+    length = header[3];
+
+    if (version == 0 || length > SLOT_SIZE - CONFIG_OVERHEAD)
+        return false;
+
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = 0; i < CONFIG_HEADER_SIZE + length; i++)
+        crc = configCrc(crc, eeprom_read_byte((const uint8_t*)address(slot, i)));
+
+    uint16_t stored = eeprom_read_word((const uint16_t*)address(slot, CONFIG_HEADER_SIZE + length));
+    return crc == stored;
+}
+
+// Loads the newest valid record into data. Returns its version, or 0 if no
+// slot is valid. Only a record of VERSION is copied; otherwise data keeps
+// its defaults.
+template <typename Record, uint8_t VERSION, uint16_t BASE, uint8_t SLOTS, uint8_t SLOT_SIZE>
+uint8_t ConfigStore<Record, VERSION, BASE, SLOTS, SLOT_SIZE>::load()
+{
+    return read(data);
+}
+
+// Like load(), but into another record, e.g. to revert part of the settings.
+// While a save is in progress its snapshot counts as the newest record.
+template <typename Record, uint8_t VERSION, uint16_t BASE, uint8_t SLOTS, uint8_t SLOT_SIZE>
+uint8_t ConfigStore<Record, VERSION, BASE, SLOTS, SLOT_SIZE>::read(Record& record)
+{
+    if (writing)
+    {
+        memcpy(&record, pending + CONFIG_HEADER_SIZE, sizeof(Record));
+        return VERSION;
+    }
+
+    bool found = false;
+    uint8_t bestVersion = 0;
+    uint8_t bestLength = 0;
+
+    for (uint8_t slot = 0; slot < SLOTS; slot++)
+    {
+        uint16_t slotSequence;
+        uint8_t version, length;
+
+        if (!readSlot(slot, slotSequence, version, length))
+            continue;
+
+        //Sequence numbers wrap, compare by distance
+        if (!found || (int16_t)(slotSequence - sequence) > 0)
+        {
+            found = true;
+            newest = slot;
+            sequence = slotSequence;
+            bestVersion = version;
+            bestLength = length;
+        }
+    }
+
+    if (!found || bestVersion != VERSION)
+        return bestVersion;
+
+    uint8_t length = bestLength < sizeof(Record) ? bestLength : sizeof(Record);
+    eeprom_read_block(&record, (const void*)address(newest, CONFIG_HEADER_SIZE), length);
+    return bestVersion;
+}
+
+// Snapshots record (normally data) and queues it for the next slot. Saving
+// again before the write has finished restarts it in the same slot with the
+// newer snapshot.
+template <typename Record, uint8_t VERSION, uint16_t BASE, uint8_t SLOTS, uint8_t SLOT_SIZE>
+void ConfigStore<Record, VERSION, BASE, SLOTS, SLOT_SIZE>::save(const Record& record)
+{
+    if (!writing)
+    {
+        target = (newest + 1) % SLOTS;
+        sequence++;
+    }
+
+    pending[0] = sequence & 0xFF;
+    pending[1] = sequence >> 8;
+    pending[2] = VERSION;
+    pending[3] = sizeof(Record);
+    memcpy(pending + CONFIG_HEADER_SIZE, &record, sizeof(Record));
+
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = 0; i < CONFIG_HEADER_SIZE + sizeof(Record); i++)
+        crc = configCrc(crc, pending[i]);
+
+    pending[CONFIG_HEADER_SIZE + sizeof(Record)] = crc & 0xFF;
+    pending[CONFIG_HEADER_SIZE + sizeof(Record) + 1] = crc >> 8;
+
+    written = 0;
+    writing = true;
+}
+
+// Call every loop. Skips bytes that already hold the right value and starts
+// at most one EEPROM write, only when the previous one has completed.
+template <typename Record, uint8_t VERSION, uint16_t BASE, uint8_t SLOTS, uint8_t SLOT_SIZE>
+void ConfigStore<Record, VERSION, BASE, SLOTS, SLOT_SIZE>::update()
+{
+    if (!writing || !eeprom_is_ready())
+        return;
+
+    while (written < sizeof(pending) && eeprom_read_byte((const uint8_t*)address(target, written)) == pending[written])
+        written++;
+
+    if (written < sizeof(pending))
+    {
+        eeprom_write_byte((uint8_t*)address(target, written), pending[written]);
+        written++;
+        return;
+    }
+
+    writing = false;
+    newest = target;
+}
+
+#endif
@@ -0,0 +1,385 @@
+#ifndef FRAMING_H
+#define FRAMING_H
+
+#include <inttypes.h>
+#include <string.h>
+#include "coms.h"
+
+// Byte-at-a-time framing engine shared by the UBX, GPU and Nextion links.
+//
+// A link is described at compile time by four policies:
+//   Header     - fixed leading bytes (or none)
+//   Length     - total frame length once enough bytes are known
+//   Checksum   - trailing checksum, validated before a frame is reported
+//   Terminator - fixed trailing bytes that end a variable length frame
+//   Filter     - optional: frames the consumer has no use for are skipped
+//                without being buffered or checksummed
+//
+// The parser keeps every byte of a candidate frame in a fixed buffer. When a
+// candidate turns out to be bad (header mismatch, impossible length, bad
+// checksum) only its first byte is dropped and the rest is rescanned, so the
+// header of a frame hidden inside a broken one is never lost. The same holds
+// for skipped frames: their bytes are still watched for a header, so a
+// corrupted length cannot swallow the frames behind it.
+//
+// This file is kept identical in datalogger/ and nanogpu/.
+
+enum FrameStatus {
+    FRAME_NONE,
+    FRAME_OK,
+    FRAME_BAD_CHECKSUM
+};
+
+enum FrameFilter {
+    FILTER_ACCEPT,
+    FILTER_SKIP,
+    FILTER_REJECT
+};
+
+const int16_t LENGTH_UNKNOWN = -1;
+const int16_t LENGTH_INVALID = 0;
+
+template <uint8_t... BYTES>
+struct FixedHeader {
+    static const uint8_t LENGTH = sizeof...(BYTES);
+
+    static uint8_t at(uint8_t i)
+    {
+        static const uint8_t bytes[] = { BYTES... };
+        return bytes[i];
+    }
+};
+
+struct NoHeader {
+    static const uint8_t LENGTH = 0;
+
+    static uint8_t at(uint8_t) { return 0; }
+};
+
+template <uint8_t BYTE, uint8_t COUNT>
+struct FixedTerminator {
+    static const uint8_t LENGTH = COUNT;
+
+    static bool endsWith(const uint8_t* buffer, uint8_t count)
+    {
+        if (count < COUNT)
+            return false;
+
+        for (uint8_t i = count - COUNT; i < count; i++)
+            if (buffer[i] != BYTE)
+                return false;
+
+        return true;
+    }
+};
+
+struct NoTerminator {
+    static const uint8_t LENGTH = 0;
+
+    static bool endsWith(const uint8_t*, uint8_t) { return false; }
+};
+
+// Fletcher-8 as used by UBX, over buffer[START, end - 2), stored in the two
+// bytes before end.
+template <uint8_t START>
+struct FletcherChecksum {
+    static const uint8_t LENGTH = 2;
+
+    static bool isValid(const uint8_t* buffer, uint8_t end)
+    {
+        if (end < START + LENGTH)
+            return false;
+
+        uint8_t ckA = 0, ckB = 0;
+        for (uint8_t i = START; i < end - LENGTH; i++)
+        {
+            ckA += buffer[i];
+            ckB += ckA;
+        }
+
+        return buffer[end - 2] == ckA && buffer[end - 1] == ckB;
+    }
+};
+
+struct NoChecksum {
+    static const uint8_t LENGTH = 0;
+
+    static bool isValid(const uint8_t*, uint8_t) { return true; }
+};
+
+// UBX: class, id and a little-endian payload length follow the header.
+struct UbxLength {
+    static int16_t frameLength(const uint8_t* buffer, uint8_t count)
+    {
+        if (count < 6)
+            return LENGTH_UNKNOWN;
+
+        uint16_t payload = buffer[4] | (buffer[5] << 8);
+
+        if (payload > 1024)
+            return LENGTH_INVALID;
+
+        return 6 + payload + 2;
+    }
+};
+
+// GPU link: the package id after the header selects a fixed payload size.
+struct GpuLength {
+    static int16_t frameLength(const uint8_t* buffer, uint8_t count)
+    {
+        if (count < sizeof(GPU_HEADER) + 1)
+            return LENGTH_UNKNOWN;
+
+        uint8_t payload;
+
+        switch (buffer[sizeof(GPU_HEADER)])
+        {
+            case PKG_VALUES_ID: payload = sizeof(PKG_VALUES); break;
+            case PKG_STATUS_ID: payload = sizeof(PKG_STATUS); break;
+            case PKG_MODE_ID: payload = sizeof(PKG_MODE); break;
+            case PKG_CALIBRATE_ID: payload = sizeof(PKG_CALIBRATE); break;
+            case PKG_STORE_CALIBRATION_ID: payload = sizeof(PKG_STORE_CALIBRATION); break;
+            case PKG_READ_CALIBRATION_ID: payload = sizeof(PKG_READ_CALIBRATION); break;
+            case PKG_SIGNAL_ID: payload = sizeof(PKG_SIGNAL); break;
+            default: return LENGTH_INVALID;
+        }
+
+        return sizeof(GPU_HEADER) + 1 + payload + 2;
+    }
+};
+
+// Frames that end at their terminator.
+struct TerminatedLength {
+    static int16_t frameLength(const uint8_t*, uint8_t) { return LENGTH_UNKNOWN; }
+};
+
+// Called once the length is known, with the header and length bytes buffered.
+struct AcceptAll {
+    static FrameFilter check(const uint8_t*) { return FILTER_ACCEPT; }
+};
+
+template <class Header, class Length, class Checksum, class Terminator, uint8_t SIZE, class Filter = AcceptAll>
+class FrameParser {
+    uint8_t buffer[SIZE];
+    uint8_t count = 0;
+    uint8_t frameLength = 0;
+    uint16_t skipRemaining = 0;
+    uint8_t skipMatched = 0; //Header bytes seen at the end of the skipped bytes
+    bool discarding = false;
+
+    private:
+        void drop(uint8_t n)
+        {
+            count -= n;
+            memmove(buffer, buffer + n, count);
+        }
+
+        //Drop the first byte and skip ahead to the next possible header
+        void resync()
+        {
+            uint8_t next = 1;
+
+            if (Header::LENGTH > 0)
+                while (next < count && buffer[next] != Header::at(0))
+                    next++;
+
+            drop(next);
+        }
+
+        bool headerMatches()
+        {
+            uint8_t n = count < Header::LENGTH ? count : Header::LENGTH;
+
+            for (uint8_t i = 0; i < n; i++)
+                if (buffer[i] != Header::at(i))
+                    return false;
+
+            return true;
+        }
+
+        FrameStatus scanTerminated()
+        {
+            if (!Terminator::endsWith(buffer, count))
+            {
+                //Overlong frame: throw it away up to the next terminator, but
+                //keep a partial terminator so it is still recognised
+                if (count == SIZE)
+                {
+                    drop(count - (Terminator::LENGTH - 1));
+                    discarding = true;
+                }
+
+                return FRAME_NONE;
+            }
+
+            if (discarding)
+            {
+                discarding = false;
+                count = 0;
+                return FRAME_NONE;
+            }
+
+            if (!Checksum::isValid(buffer, count - Terminator::LENGTH))
+            {
+                count = 0;
+                return FRAME_BAD_CHECKSUM;
+            }
+
+            frameLength = count;
+            return FRAME_OK;
+        }
+
+        //Tracks a header appearing in skipped bytes
+        bool skipMatch(uint8_t c)
+        {
+            if (Header::LENGTH == 0)
+                return false;
+
+            if (c == Header::at(skipMatched))
+                skipMatched++;
+            else
+                skipMatched = c == Header::at(0) ? 1 : 0;
+
+            return skipMatched == Header::LENGTH;
+        }
+
+        FrameStatus scan()
+        {
+            FrameStatus status = FRAME_NONE;
+
+            while (count > 0)
+            {
+                if (!headerMatches())
+                {
+                    resync();
+                    continue;
+                }
+
+                if (count < Header::LENGTH)
+                    return status;
+
+                if (Terminator::LENGTH > 0)
+                    return scanTerminated();
+
+                int16_t total = Length::frameLength(buffer, count);
+
+                if (total == LENGTH_UNKNOWN)
+                    return status;
+
+                FrameFilter filter = total == LENGTH_INVALID ? FILTER_REJECT : Filter::check(buffer);
+
+                if (filter == FILTER_SKIP)
+                {
+                    //Watch the skipped bytes for a header in case the length
+                    //was corrupted
+                    uint8_t end = count < total ? count : total;
+                    uint8_t i = Header::LENGTH;
+                    skipMatched = 0;
+                    while (i < end && !skipMatch(buffer[i]))
+                        i++;
+
+                    if (i < end)
+                    {
+                        drop(i + 1 - Header::LENGTH);
+                        continue;
+                    }
+
+                    //Keep a partial header at the end, it may start the next frame
+                    if (count >= total)
+                    {
+                        drop(total - skipMatched);
+                        continue;
+                    }
+
+                    skipRemaining = total - count;
+                    count = 0;
+                    return status;
+                }
+
+                if (filter == FILTER_REJECT || total > SIZE)
+                {
+                    resync();
+                    continue;
+                }
+
+                if (count < total)
+                    return status;
+
+                if (Checksum::isValid(buffer, total))
+                {
+                    frameLength = total;
+                    return FRAME_OK;
+                }
+
+                status = FRAME_BAD_CHECKSUM;
+                resync();
+            }
+
+            return status;
+        }
+
+    public:
+        FrameStatus push(uint8_t c)
+        {
+            if (skipRemaining > 0)
+            {
+                skipRemaining--;
+                bool found = skipMatch(c);
+
+                if (!found && skipRemaining > 0)
+                    return FRAME_NONE;
+
+                //A header inside the skipped frame means its length was
+                //probably corrupted, parse from the header instead. A partial
+                //header at the end may be the start of the next frame.
+                skipRemaining = 0;
+                for (count = 0; count < skipMatched; count++)
+                    buffer[count] = Header::at(count);
+
+                return found ? scan() : FRAME_NONE;
+            }
+
+            if (frameLength > 0)
+            {
+                drop(frameLength);
+                frameLength = 0;
+            }
+
+            if (count == SIZE)
+                resync();
+
+            buffer[count++] = c;
+            return scan();
+        }
+
+        void reset()
+        {
+            count = frameLength = 0;
+            skipRemaining = 0;
+            skipMatched = 0;
+            discarding = false;
+        }
+
+        //Valid after push() returned FRAME_OK, until the next push()
+        const uint8_t* frame() { return buffer; }
+        uint8_t length() { return frameLength; }
+        const uint8_t* payload() { return buffer + Header::LENGTH; }
+
+        uint8_t payloadLength()
+        {
+            return frameLength - Header::LENGTH - Checksum::LENGTH - Terminator::LENGTH;
+        }
+};
+
+// u-blox UBX: B5 62, class, id, length, payload, checksum over class..payload
+typedef FrameParser<FixedHeader<0xB5, 0x62>, UbxLength, FletcherChecksum<2>, NoTerminator, 100> UbxParser;
+
+// Datalogger -> NanoGpu: GPU_HEADER, package id, payload, checksum over payload.
+// The id is not covered, so a corrupted id between same-sized packages passes.
+// Covering it would change the wire format and needs a versioned protocol.
+typedef FrameParser<FixedHeader<0xAC, 0xDC, 0xFC>, GpuLength, FletcherChecksum<4>, NoTerminator, 40> GpuParser;
+
+// Nextion returns: code byte, data, FF FF FF
+typedef FrameParser<NoHeader, TerminatedLength, NoChecksum, FixedTerminator<0xFF, 3>, 40> NextionParser;
+
+#endif
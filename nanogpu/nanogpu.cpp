@@ -13,19 +13,26 @@ void NanoGpu::setup()
     Serial.begin(9600);
     display.begin();
 
-    int eepromState = EEPROM.read(0);
+    uint8_t version = calibration.load();
 
-    // Unwritten EEPROM locations have the value 255, 
-    // so this means EEPROM has not been initiated
-    if (eepromState == 255)
+    if (version == CALIBRATION_VERSION)
     {
-        initEEPROM();
-        setStatus("ROM Init");
+        setStatus("ROM Read");
+    }
+    else if (version > 0)
+    {
+        //Written by another firmware, nothing to migrate from yet
+        calibration.save();
+        setStatus("ROM Rset");
+    }
+    else if (importLegacyCalibration())
+    {
+        calibration.save();
+        setStatus("ROM Conv");
     }
     else
     {
-        readEEPROM();
-        setStatus("ROM Read");
+        setStatus("ROM Init");
     }
 }
 
@@ -55,22 +62,14 @@ void NanoGpu::setStatus(const char newStatus[])
     }
 }
 
-void NanoGpu::initEEPROM()
+// Older firmware stored mins/maxs pairs at fixed offsets from 0, with
+// byte 0 (the low byte of mins[0]) doubling as the "initialised" flag.
+bool NanoGpu::importLegacyCalibration()
 {
-    for (int i = 0; i < VALUES_COUNT; i++)
-    {
-        int minIndex = i * sizeof(uint16_t) * 2;
-        int maxIndex = minIndex + sizeof(uint16_t);
+    // Unwritten EEPROM locations have the value 255
+    if (EEPROM.read(0) == 255)
+        return false;
 
-        EEPROM.put(minIndex, mins[i]);
-        EEPROM.put(maxIndex, maxs[i]);
-    }
-
-    EEPROM.write(0,0);
-}
-
-void NanoGpu::readEEPROM()
-{
     for (int i = 0; i < VALUES_COUNT; i++)
     {
         int minIndex = i * sizeof(uint16_t) * 2;
@@ -79,140 +78,61 @@ void NanoGpu::readEEPROM()
         EEPROM.get(minIndex, mins[i]);
         EEPROM.get(maxIndex, maxs[i]);
     }
+
+    return true;
 }
 
-bool NanoGpu::checksumIsValid()
+const uint8_t* NanoGpu::packageData()
 {
-    checksum[0] = 0x00;
-    checksum[1] = 0x00;
-
-    int realPayload = payloadSize - sizeof(GPU_HEADER) - 1;
+    //Payload starts with the package id
+    return parser.payload() + 1;
+}
 
-    for (int i = 0; i < realPayload; i++) 
+void NanoGpu::processPackage()
+{
+    switch (parser.payload()[0])
     {
-        if (i < realPayload - 2)
-        {
-            checksum[0] += buffer[i];
-            checksum[1] += checksum[0];
-        }
-        else if (buffer[i] != checksum[i - (realPayload - 2)])
-        {
-            return false;
-        }
+        case PKG_MODE_ID:
+            updateMode();
+            break;
+        case PKG_STATUS_ID:
+            updateStatus();
+            break;
+        case PKG_VALUES_ID:
+            updateValues();
+            break;
+        case PKG_CALIBRATE_ID:
+            updateCalibration();
+            break;
+        case PKG_STORE_CALIBRATION_ID:
+            storeCalibration();
+            break;
+        case PKG_READ_CALIBRATION_ID:
+            readCalibration();
+            break;
+        case PKG_SIGNAL_ID:
+            updateSignal();
+            break;
+        default:
+            break;
     }
-    
-    return true;
-};
+}
 
 void NanoGpu::processSerial()
 {
     while ( Serial.available() ) 
     {
-        byte c = Serial.read();
-        
-        if ( fpos < sizeof(GPU_HEADER)) 
-        {
-
-            if ( c == GPU_HEADER[fpos])
-                fpos++;
-            else
-                fpos = 0;
-        }
-        else if (fpos == sizeof(GPU_HEADER)) 
-        {
-            package = c;
-
-            switch (package)
-            {
-                case PKG_MODE_ID:
-                    fpos++;
-                    payloadSize = sizeof(GPU_HEADER) + sizeof(PKG_MODE) + CHECKSUM_LENGTH;
-                    break;
-                case PKG_STATUS_ID:
-                    fpos++;
-                    payloadSize = sizeof(GPU_HEADER) + sizeof(PKG_STATUS) + CHECKSUM_LENGTH;
-                    break;
-                case PKG_VALUES_ID:
-                    fpos++;
-                    payloadSize = sizeof(GPU_HEADER) + sizeof(PKG_VALUES) + CHECKSUM_LENGTH;
-                    break;
-                case PKG_CALIBRATE_ID:
-                    fpos++;
-                    payloadSize = sizeof(GPU_HEADER) + sizeof(PKG_CALIBRATE) + CHECKSUM_LENGTH;
-                    break;
-                case PKG_STORE_CALIBRATION_ID:
-                    fpos++;
-                    payloadSize = sizeof(GPU_HEADER) + sizeof(PKG_STORE_CALIBRATION) + CHECKSUM_LENGTH;
-                    break;
-                case PKG_READ_CALIBRATION_ID:
-                    fpos++;
-                    payloadSize = sizeof(GPU_HEADER) + sizeof(PKG_READ_CALIBRATION) + CHECKSUM_LENGTH;
-                    break;
-                case PKG_SIGNAL_ID:
-                    fpos++;
-                    payloadSize = sizeof(GPU_HEADER) + sizeof(PKG_SIGNAL) + CHECKSUM_LENGTH;
-                    break;
-                default:
-                    fpos = 0;
-                    break;
-            }
-        }
-        else
+        switch (parser.push(Serial.read()))
         {
-            if (fpos < payloadSize)
-            {
-                buffer[fpos-sizeof(GPU_HEADER) - 1] = c;
-                fpos++;
-
-                if (fpos == payloadSize)
-                {
-                    fpos = 0;
-
-                    if (checksumIsValid())
-                    {
-                        switch (package)
-                        {
-                            case PKG_MODE_ID:
-                                updateMode();
-                                break;
-                            case PKG_STATUS_ID:
-                                updateStatus();
-                                break;
-                            case PKG_VALUES_ID:
-                                updateValues();
-                                break;
-                            case PKG_CALIBRATE_ID:
-                                updateCalibration();
-                                break;
-                            case PKG_STORE_CALIBRATION_ID:
-                                storeCalibration();
-                                break;
-                            case PKG_READ_CALIBRATION_ID:
-                                readCalibration();
-                                break;
-                            case PKG_SIGNAL_ID:
-                                updateSignal();
-                                break;
-                            default:
-                                break;
-                        }
-
-                        Serial.write(0x00);
-                    }
-                    else
-                    {
-                        Serial.write(0xFF);
-                    }
-
-                    return;
-                }
-            } 
-            else
-            {
-                fpos = 0;
-                Serial.write(0xEE);
+            case FRAME_OK:
+                processPackage();
+                Serial.write(0x00);
                 return;
-            }
+            case FRAME_BAD_CHECKSUM:
+                Serial.write(0xFF);
+                return;
+            default:
+                break;
         }
     }
     Serial.write(0xDD);
@@ -220,7 +140,7 @@ void NanoGpu::processSerial()
 
 void NanoGpu::updateMode()
 {
-    PKG_MODE modePackage = *((PKG_MODE*)(&buffer));
+    PKG_MODE modePackage = *((PKG_MODE*)packageData());
     mode = (GPU_MODE) modePackage.mode;
 
     if (mode == VALUES)
@@ -231,7 +151,7 @@ void NanoGpu::updateMode()
 
 void NanoGpu::updateCalibration()
 {
-    PKG_CALIBRATE package = *((PKG_CALIBRATE*)(&buffer));
+    PKG_CALIBRATE package = *((PKG_CALIBRATE*)packageData());
 
     calibrateIndex = package.channel;
 
@@ -251,35 +171,39 @@ void NanoGpu::updateCalibration()
 
 void NanoGpu::storeCalibration()
 {
-    PKG_STORE_CALIBRATION package = *((PKG_STORE_CALIBRATION*)(&buffer));
+    PKG_STORE_CALIBRATION package = *((PKG_STORE_CALIBRATION*)packageData());
 
     if (package.channel >= VALUES_COUNT)
         return;
 
-    int minIndex = package.channel * sizeof(uint16_t) * 2;
-    int maxIndex = minIndex + sizeof(uint16_t);
+    //Only this channel is confirmed; the others keep their stored (or
+    //default) range even while one of them is being calibrated
+    GpuCalibration stored;
+    calibration.read(stored);
 
-    EEPROM.put(minIndex, mins[package.channel]);
-    EEPROM.put(maxIndex, maxs[package.channel]);
+    stored.mins[package.channel] = mins[package.channel];
+    stored.maxs[package.channel] = maxs[package.channel];
+    calibration.save(stored);
 }
 
 void NanoGpu::readCalibration()
 {
-    PKG_READ_CALIBRATION package = *((PKG_READ_CALIBRATION*)(&buffer));
+    PKG_READ_CALIBRATION package = *((PKG_READ_CALIBRATION*)packageData());
 
     if (package.channel >= VALUES_COUNT)
         return;
 
-    int minIndex = package.channel * sizeof(uint16_t) * 2;
-    int maxIndex = minIndex + sizeof(uint16_t);
+    //Reverts to the last stored range, or the default if none was stored
+    GpuCalibration stored;
+    calibration.read(stored);
 
-    EEPROM.get(minIndex, mins[package.channel]);
-    EEPROM.get(maxIndex, maxs[package.channel]);
+    mins[package.channel] = stored.mins[package.channel];
+    maxs[package.channel] = stored.maxs[package.channel];
 }
 
 void NanoGpu::updateValues() 
 {
-    PKG_VALUES valuePackage = *((PKG_VALUES*)(&buffer));
+    PKG_VALUES valuePackage = *((PKG_VALUES*)packageData());
 
     for (int i = 0; i < VALUES_COUNT; i++)
     {
@@ -303,14 +227,14 @@ void NanoGpu::updateValues()
 
 void NanoGpu::updateStatus() 
 {
-    PKG_STATUS statusPackage = *((PKG_STATUS*)(&buffer));
+    PKG_STATUS statusPackage = *((PKG_STATUS*)packageData());
 
     setStatus(statusPackage.characters);
 }
 
 void NanoGpu::updateSignal()
 {
-    PKG_SIGNAL signalPackage = *((PKG_SIGNAL*)(&buffer));
+    PKG_SIGNAL signalPackage = *((PKG_SIGNAL*)packageData());
     signalStrength = signalPackage.signalStrength;
 }
 
@@ -353,23 +277,14 @@ void NanoGpu::update()
     if (Serial.available())
         processSerial();
 
+    calibration.update();
+
     if (millis() > nextDrawTime)
     {
         nextDrawTime = millis() + 20;
         display.clearBuffer();    
 
         renderSignal();
-        // display.drawBox(fpos, 0, payloadSize - fpos, 1);
-
-        // for (int i = 0; i < 128; i+= 2)
-        // {
-        //     display.drawBox(i, 58, 1, 2);
-        // }
-
-        // display.drawBox(checksum[0] * 2, 60, 2, 1);
-        // display.drawBox(buffer[payloadSize - 2] * 2, 61, 2, 1);
-        // display.drawBox(checksum[1] * 2, 62, 2, 1);
-        // display.drawBox(buffer[payloadSize - 1] * 2, 63, 2, 1);
 
         switch(mode)
         {
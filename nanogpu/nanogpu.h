@@ -4,21 +4,34 @@
 #include <U8g2lib.h>
 #include <inttypes.h>
 #include "coms.h"
+#include "framing.h"
+#include "configstore.h"
+
+// Per-channel display range, persisted with the config store. Only ever
+// append fields (see configstore.h).
+struct GpuCalibration {
+    uint16_t mins[VALUES_COUNT] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0};
+    uint16_t maxs[VALUES_COUNT] = {120,120,120,120,120,120,1000,1000,1000,1000,1000,1000,1000,1000};
+};
+
+const uint8_t CALIBRATION_VERSION = 1;
+const uint16_t CALIBRATION_EEPROM = 64; //Below is the fixed layout of older firmware
+const uint8_t CALIBRATION_SLOTS = 8;
+const uint8_t CALIBRATION_SLOT_SIZE = 64;
+
+typedef ConfigStore<GpuCalibration, CALIBRATION_VERSION, CALIBRATION_EEPROM, CALIBRATION_SLOTS, CALIBRATION_SLOT_SIZE> CalibrationStore;
 
 class NanoGpu {
-    int fpos = 0;
-    int payloadSize = 3;
-    byte package = 0x00;
-    unsigned char checksum[2] = {0x00, 0x00};
-    unsigned char buffer[40];
+    GpuParser parser;
     U8G2_SH1106_128X64_NONAME_F_HW_I2C display = U8G2_SH1106_128X64_NONAME_F_HW_I2C(U8G2_R0);
 
     GPU_MODE mode = STATUSTEXT;    
     char status[10] = "IDLE";
     uint8_t signalStrength = 0x00;
     uint16_t values[VALUES_COUNT] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0};
-    uint16_t mins[VALUES_COUNT] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0};
-    uint16_t maxs[VALUES_COUNT] = {120,120,120,120,120,120,1000,1000,1000,1000,1000,1000,1000,1000};
+    CalibrationStore calibration;
+    uint16_t* mins = calibration.data.mins;
+    uint16_t* maxs = calibration.data.maxs;
     
     uint8_t calibrateIndex = 255;
 
@@ -32,14 +45,14 @@ class NanoGpu {
         void updateStatus();
         void updateSignal();
         void updateValues(); 
-        bool checksumIsValid();
+        void processPackage();
         void processSerial();
+        const uint8_t* packageData();
         void renderStatusText();
         void renderValues();
         void renderSignal();
 
-        void readEEPROM();
-        void initEEPROM();
+        bool importLegacyCalibration();
 
     public:
         void setStatus(const char newStatus[]);
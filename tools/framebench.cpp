@@ -0,0 +1,410 @@
+// Fuzz and throughput bench for the shared framing engine (framing.h).
+//
+//   framebench [frames] [seed]
+//
+// For each link (UBX, GPS, GPU, Nextion) a stream of valid frames is mixed with
+// random noise, fake headers, truncated frames and corrupted frames. Intact
+// frames carry a unique tag and must come out of the parser byte for byte.
+// An intact frame overlapped by a damaged one that passed its checksum by
+// chance counts as swallowed, not lost. The GPS stream also carries frames the
+// datalogger's message filter skips or rejects. The parser is then timed on
+// clean and on pure-noise input.
+//
+// Exits non-zero if any intact frame was lost.
+//
+// Build: g++ -std=c++17 -O2 -o framebench tools/framebench.cpp
+
+#include "../datalogger/framing.h"
+#include "../datalogger/gps.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+typedef std::vector<uint8_t> Bytes;
+
+// A frame and the offset of its first byte in the fuzz stream
+struct Placed {
+    Bytes bytes;
+    size_t start;
+};
+
+static uint32_t rngState = 1;
+
+static uint32_t rnd()
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+static uint32_t rnd(uint32_t n)
+{
+    return rnd() % n;
+}
+
+static void appendFletcher(Bytes& frame, size_t start)
+{
+    uint8_t ckA = 0, ckB = 0;
+    for (size_t i = start; i < frame.size(); i++)
+    {
+        ckA += frame[i];
+        ckB += ckA;
+    }
+
+    frame.push_back(ckA);
+    frame.push_back(ckB);
+}
+
+static void appendTag(Bytes& frame, uint32_t tag)
+{
+    for (int i = 0; i < 4; i++)
+        frame.push_back(tag >> (i * 8));
+}
+
+static Bytes ubxFrame(uint32_t tag)
+{
+    Bytes frame = { 0xB5, 0x62, (uint8_t)rnd(), (uint8_t)rnd() };
+    uint16_t length = 4 + rnd(89);
+    frame.push_back(length & 0xFF);
+    frame.push_back(length >> 8);
+    appendTag(frame, tag);
+
+    for (uint16_t i = 4; i < length; i++)
+        frame.push_back(rnd());
+
+    appendFletcher(frame, 2);
+    return frame;
+}
+
+static Bytes ubxFrame(uint8_t cls, uint8_t id, uint16_t length)
+{
+    Bytes frame = { 0xB5, 0x62, cls, id, (uint8_t)(length & 0xFF), (uint8_t)(length >> 8) };
+
+    for (uint16_t i = 0; i < length; i++)
+        frame.push_back(rnd());
+
+    appendFletcher(frame, 2);
+    return frame;
+}
+
+// Frames Gps handles. Damaged ones (tag 0) also come from classes that the
+// filter skips or rejects.
+static Bytes gpsFrame(uint32_t tag)
+{
+    static const uint8_t handled[][2] = {
+        { NAV_CLASS, NAV_PVT_ID }, { NAV_CLASS, NAV_VELNED_ID },
+        { HNR_CLASS, HNR_PVT_ID }, { ACK_CLASS, ACK_ACK_ID }, { ACK_CLASS, ACK_NAK_ID }
+    };
+
+    if (tag == 0 && rnd(2))
+        return ubxFrame(rnd(2) ? 0x0A : 0x30, rnd(), rnd(2) ? rnd(89) : rnd(GPS_MAX_SKIP_PAYLOAD + 1));
+
+    const uint8_t* type = handled[rnd(sizeof(handled) / sizeof(handled[0]))];
+    Bytes frame = ubxFrame(type[0], type[1], 4 + rnd(89));
+
+    for (int i = 0; i < 4; i++)
+        frame[6 + i] = tag >> (i * 8);
+
+    frame.resize(frame.size() - 2);
+    appendFletcher(frame, 2);
+    return frame;
+}
+
+// Traffic the datalogger has no handler for: skipped (MON, other NAV
+// messages, up to the largest skippable length) or from an unknown class.
+static Bytes gpsFiller()
+{
+    switch (rnd(3))
+    {
+        case 0: return ubxFrame(0x0A, rnd(), rnd(GPS_MAX_SKIP_PAYLOAD + 1));
+        case 1: return ubxFrame(NAV_CLASS, 0x35, 8 + 12 * rnd(65));
+        default: return ubxFrame(0x30 + rnd(16), rnd(), rnd(120));
+    }
+}
+
+static Bytes gpuFrame(uint32_t tag)
+{
+    static const uint8_t ids[] = {
+        PKG_VALUES_ID, PKG_STATUS_ID, PKG_MODE_ID, PKG_CALIBRATE_ID,
+        PKG_STORE_CALIBRATION_ID, PKG_READ_CALIBRATION_ID, PKG_SIGNAL_ID
+    };
+
+    Bytes frame(GPU_HEADER, GPU_HEADER + sizeof(GPU_HEADER));
+
+    //Only packages large enough to carry the tag are used for intact frames
+    if (tag == 0)
+        frame.push_back(ids[rnd(sizeof(ids))]);
+    else
+    {
+        frame.push_back(rnd(2) ? PKG_VALUES_ID : PKG_STATUS_ID);
+        appendTag(frame, tag);
+    }
+
+    int16_t total = GpuLength::frameLength(frame.data(), frame.size());
+    while ((int16_t)frame.size() < total - 2)
+        frame.push_back(rnd());
+
+    appendFletcher(frame, sizeof(GPU_HEADER) + 1);
+    return frame;
+}
+
+static Bytes nextionFrame(uint32_t tag)
+{
+    Bytes frame;
+
+    if (tag == 0 && rnd(2) == 0)
+    {
+        //Touch event: 0x65, page, component, event
+        frame = { 0x65, (uint8_t)rnd(10), (uint8_t)rnd(30), (uint8_t)rnd(2) };
+    }
+    else
+    {
+        frame.push_back('p');
+
+        for (uint32_t t = tag; t > 0; t /= 26)
+            frame.push_back('a' + t % 26);
+
+        uint8_t length = rnd(24);
+        for (uint8_t i = 0; i < length; i++)
+            frame.push_back('A' + rnd(26));
+    }
+
+    frame.insert(frame.end(), { 0xFF, 0xFF, 0xFF });
+    return frame;
+}
+
+static Bytes noise(uint8_t headerByte, bool terminated)
+{
+    Bytes bytes;
+    uint32_t length = rnd(60);
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        uint8_t c = rnd();
+
+        //Nextion noise may not contain a terminator of its own
+        if (terminated && c == 0xFF)
+            c = 0xFE;
+
+        //Sprinkle header starts to exercise resynchronisation
+        if (!terminated && rnd(8) == 0)
+            c = headerByte;
+
+        bytes.push_back(c);
+    }
+
+    return bytes;
+}
+
+struct FuzzResult {
+    size_t intact = 0;
+    size_t recovered = 0;
+    size_t lost = 0;
+    size_t swallowed = 0;
+    size_t spurious = 0;
+    size_t damaged = 0;
+};
+
+template <class Parser>
+static void collect(Parser& parser, const Bytes& stream, std::vector<Placed>& out)
+{
+    //Drain frames still queued behind a rejected candidate
+    for (size_t i = 0; i < stream.size() + 256; i++)
+        if (parser.push(i < stream.size() ? stream[i] : 0x00) == FRAME_OK)
+            out.push_back({ Bytes(parser.frame(), parser.frame() + parser.length()), i + 1 - parser.length() });
+}
+
+static bool overlaps(const Placed& a, const Placed& b)
+{
+    return a.start < b.start + b.bytes.size() && b.start < a.start + a.bytes.size();
+}
+
+static void match(const std::vector<Placed>& expected, const std::vector<Placed>& recovered, FuzzResult& result)
+{
+    std::vector<const Placed*> spurious;
+    std::vector<size_t> missing;
+    size_t next = 0;
+
+    for (const Placed& frame : recovered)
+    {
+        size_t k = next;
+        while (k < expected.size() && expected[k].bytes != frame.bytes)
+            k++;
+
+        if (k == expected.size())
+        {
+            spurious.push_back(&frame);
+            continue;
+        }
+
+        for (; next < k; next++)
+            missing.push_back(next);
+
+        result.recovered++;
+        next = k + 1;
+    }
+
+    for (; next < expected.size(); next++)
+        missing.push_back(next);
+
+    result.spurious = spurious.size();
+
+    for (size_t k : missing)
+    {
+        bool swallowed = false;
+        for (const Placed* frame : spurious)
+            swallowed |= overlaps(expected[k], *frame);
+
+        if (swallowed)
+            result.swallowed++;
+        else
+            result.lost++;
+    }
+}
+
+template <class Parser>
+static FuzzResult fuzz(Bytes (*generate)(uint32_t), Bytes (*filler)(), uint8_t headerByte, bool terminated, size_t frames)
+{
+    FuzzResult result;
+    std::vector<Placed> expected, recovered;
+    Bytes stream;
+
+    for (size_t n = 0; n < frames; n++)
+    {
+        switch (rnd(8))
+        {
+            case 0:
+            {
+                Bytes junk = noise(headerByte, terminated);
+                stream.insert(stream.end(), junk.begin(), junk.end());
+
+                if (terminated)
+                    stream.insert(stream.end(), { 0xFF, 0xFF, 0xFF });
+                break;
+            }
+            case 1:
+            {
+                //Truncated frame; for terminated links the terminator survives
+                Bytes frame = generate(0);
+                size_t keep = 1 + rnd(frame.size() - 1);
+
+                if (terminated)
+                    frame.erase(frame.begin() + std::min(keep, frame.size() - 3), frame.end() - 3);
+                else
+                    frame.resize(keep);
+
+                stream.insert(stream.end(), frame.begin(), frame.end());
+                result.damaged++;
+                break;
+            }
+            case 2:
+            {
+                if (terminated)
+                {
+                    //Overlong garbage that overflows the buffer
+                    for (int i = 0; i < 120; i++)
+                        stream.push_back('a' + rnd(26));
+                    stream.insert(stream.end(), { 0xFF, 0xFF, 0xFF });
+                }
+                else
+                {
+                    //Single bit flip, caught by the checksum
+                    Bytes frame = generate(0);
+                    frame[rnd(frame.size())] ^= 1 << rnd(8);
+                    stream.insert(stream.end(), frame.begin(), frame.end());
+                }
+                result.damaged++;
+                break;
+            }
+            case 3:
+            {
+                //Undamaged frames the parser has to get past without reporting
+                if (filler)
+                {
+                    Bytes frame = filler();
+                    stream.insert(stream.end(), frame.begin(), frame.end());
+                }
+                break;
+            }
+            default:
+                break;
+        }
+
+        Bytes frame = generate(n + 1);
+        expected.push_back({ frame, stream.size() });
+        stream.insert(stream.end(), frame.begin(), frame.end());
+    }
+
+    Parser parser;
+    collect(parser, stream, recovered);
+
+    result.intact = expected.size();
+    match(expected, recovered, result);
+
+    return result;
+}
+
+template <class Parser>
+static double throughput(const Bytes& stream)
+{
+    Parser parser;
+    size_t frames = 0;
+    int rounds = 0;
+    auto start = std::chrono::steady_clock::now();
+    double seconds = 0;
+
+    do
+    {
+        for (uint8_t c : stream)
+            frames += parser.push(c) == FRAME_OK;
+
+        rounds++;
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (seconds < 0.5);
+
+    //Keep the work observable
+    if (frames == (size_t)-1)
+        printf("\n");
+
+    return stream.size() * (double)rounds / seconds / 1e6;
+}
+
+template <class Parser>
+static bool run(const char name[], Bytes (*generate)(uint32_t), Bytes (*filler)(), uint8_t headerByte, bool terminated, size_t frames)
+{
+    FuzzResult result = fuzz<Parser>(generate, filler, headerByte, terminated, frames);
+
+    Bytes clean, random;
+    while (clean.size() < 1 << 20)
+    {
+        Bytes frame = generate(clean.size());
+        clean.insert(clean.end(), frame.begin(), frame.end());
+    }
+
+    while (random.size() < 1 << 20)
+        random.push_back(rnd(4) == 0 ? headerByte : rnd());
+
+    printf("%-8s intact %zu  recovered %zu  lost %zu  swallowed %zu  spurious %zu  damaged %zu  clean %.1f MB/s  noise %.1f MB/s\n",
+        name, result.intact, result.recovered, result.lost, result.swallowed, result.spurious, result.damaged,
+        throughput<Parser>(clean), throughput<Parser>(random));
+
+    //Without a checksum nothing can swallow an intact frame either
+    return result.lost == 0 && (!terminated || result.swallowed == 0);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t frames = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+    rngState = argc > 2 ? strtoul(argv[2], nullptr, 10) | 1 : 1;
+
+    bool ok = true;
+    ok &= run<UbxParser>("ubx", ubxFrame, nullptr, 0xB5, false, frames);
+    ok &= run<GpsParser>("gps", gpsFrame, gpsFiller, 0xB5, false, frames);
+    ok &= run<GpuParser>("gpu", gpuFrame, nullptr, 0xAC, false, frames);
+    ok &= run<NextionParser>("nextion", nextionFrame, nullptr, 0xFF, true, frames);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,558 @@
+// Incremental session catalog for a directory tree of datalogger .log files.
+//
+//   logcatalog index <dir> [--index <file>] [--no-pyramids]
+//   logcatalog query <index> [--bbox minLat,minLon,maxLat,maxLon] [--min-speed kmh]
+//                            [--good-fix ratio] [--max-hacc m]
+//                            [--after unix] [--before unix] [--channel name:min:max]
+//   logcatalog show <index>
+//
+// Indexing keeps entries whose size and mtime are unchanged and only decodes
+// new or modified files. Files that are not logs are remembered the same way,
+// so they are reported once rather than on every run. Queries are answered
+// from the index alone.
+// Indexing also converts each new or modified log into a level-of-detail
+// pyramid next to it (see pyramid.h) in the same pass over the file, unless
+// --no-pyramids is given.
+//
+// Build: g++ -std=c++17 -O2 -o logcatalog tools/logcatalog.cpp
+
+#include "logformat.h"
+#include "pyramid.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <stdlib.h>
+#include <time.h>
+
+namespace fs = std::filesystem;
+
+const char CATALOG_MAGIC[8] = { 'D', 'L', 'C', 'A', 'T', 'L', 'G', 0 };
+const uint16_t CATALOG_VERSION = 3;
+const uint8_t FIX_TYPES = 6;
+const uint8_t HACC_BUCKETS = 5;
+// Upper bounds (mm) of the hAcc buckets; the last bucket is open-ended.
+const uint32_t HACC_LIMITS[HACC_BUCKETS - 1] = { 1000, 2500, 5000, 10000 };
+
+struct SessionSummary {
+    uint64_t        size = 0;
+    int64_t         mtime = 0;
+    uint8_t         unreadable = 0; //Not a log file; only size and mtime are valid
+    uint32_t        startTime = 0; //Unix time from the header
+    uint32_t        endTime = 0;
+    uint64_t        samples = 0;
+    uint8_t         hasPosition = 0;
+    int32_t         minLat = 0, maxLat = 0, minLon = 0, maxLon = 0;
+    uint16_t        maxSpeed = 0; //mm/s
+    uint64_t        fixTypes[FIX_TYPES] = {};
+    //hAcc histogram of samples with a 3D fix (fixType 3 or 4)
+    uint64_t        hAccHistogram[HACC_BUCKETS] = {};
+    uint16_t        valueCount = 0;
+    std::vector<int16_t> mins, maxs;
+};
+
+typedef std::map<std::string, SessionSummary> Catalog;
+
+static uint8_t hAccBucket(uint32_t hAcc)
+{
+    for (uint8_t i = 0; i < HACC_BUCKETS - 1; i++)
+        if (hAcc < HACC_LIMITS[i])
+            return i;
+
+    return HACC_BUCKETS - 1;
+}
+
+// Decodes a log into summary, feeding builder (if given) from the same pass.
+static bool summarize(const std::string& path, SessionSummary& summary, PyramidBuilder* builder)
+{
+    LogReader reader;
+
+    if (!reader.open(path.c_str()))
+        return false;
+
+    if (builder)
+        builder->begin(reader.header);
+
+    LogClock clock(reader.header);
+    LogSample sample;
+    uint64_t elapsed = 0;
+
+    summary.startTime = reader.header.unixTime;
+    summary.valueCount = reader.header.valueCount;
+    summary.mins.assign(summary.valueCount, INT16_MAX);
+    summary.maxs.assign(summary.valueCount, INT16_MIN);
+
+    while (reader.next(sample))
+    {
+        elapsed = clock.update(sample.micros);
+        summary.samples++;
+
+        if (builder)
+            builder->add(sample, elapsed);
+
+        summary.fixTypes[sample.fixType < FIX_TYPES ? sample.fixType : 0]++;
+
+        for (uint16_t i = 0; i < summary.valueCount; i++)
+        {
+            int16_t value = channelValue(sample, i);
+            summary.mins[i] = std::min(summary.mins[i], value);
+            summary.maxs[i] = std::max(summary.maxs[i], value);
+        }
+
+        //Position and speed are only meaningful with at least a 2D fix
+        if (sample.fixType < 2 || sample.fixType > 4)
+            continue;
+
+        if (sample.fixType >= 3)
+            summary.hAccHistogram[hAccBucket(sample.hAcc)]++;
+
+        summary.maxSpeed = std::max(summary.maxSpeed, sample.speed);
+
+        if (!summary.hasPosition)
+        {
+            summary.minLat = summary.maxLat = sample.lat;
+            summary.minLon = summary.maxLon = sample.lon;
+            summary.hasPosition = 1;
+        }
+        else
+        {
+            summary.minLat = std::min(summary.minLat, sample.lat);
+            summary.maxLat = std::max(summary.maxLat, sample.lat);
+            summary.minLon = std::min(summary.minLon, sample.lon);
+            summary.maxLon = std::max(summary.maxLon, sample.lon);
+        }
+    }
+
+    summary.endTime = summary.startTime + (uint32_t)(elapsed / 1000000);
+    return true;
+}
+
+// Index file: magic, version, entry count, then one record per session.
+// All integers are little-endian as written by the host (x86/ARM).
+
+template <typename T> static void put(FILE* f, const T& value)
+{
+    fwrite(&value, sizeof(value), 1, f);
+}
+
+template <typename T> static bool get(FILE* f, T& value)
+{
+    return fread(&value, sizeof(value), 1, f) == 1;
+}
+
+static bool loadCatalog(const std::string& path, Catalog& catalog)
+{
+    FILE* f = fopen(path.c_str(), "rb");
+
+    if (!f)
+        return false;
+
+    char magic[sizeof(CATALOG_MAGIC)];
+    uint16_t version = 0;
+    uint32_t count = 0;
+    bool ok = fread(magic, 1, sizeof(magic), f) == sizeof(magic)
+        && memcmp(magic, CATALOG_MAGIC, sizeof(magic)) == 0
+        && get(f, version) && version == CATALOG_VERSION
+        && get(f, count);
+
+    for (uint32_t n = 0; ok && n < count; n++)
+    {
+        uint16_t pathLength = 0;
+        ok = get(f, pathLength);
+        std::string name(pathLength, '\0');
+        ok = ok && fread(&name[0], 1, pathLength, f) == pathLength;
+
+        SessionSummary s;
+        ok = ok && get(f, s.size) && get(f, s.mtime) && get(f, s.unreadable)
+            && get(f, s.startTime) && get(f, s.endTime) && get(f, s.samples)
+            && get(f, s.hasPosition)
+            && get(f, s.minLat) && get(f, s.maxLat) && get(f, s.minLon) && get(f, s.maxLon)
+            && get(f, s.maxSpeed) && get(f, s.fixTypes) && get(f, s.hAccHistogram)
+            && get(f, s.valueCount) && s.valueCount <= LOG_MAX_VALUES;
+
+        if (!ok)
+            break;
+
+        s.mins.resize(s.valueCount);
+        s.maxs.resize(s.valueCount);
+        ok = fread(s.mins.data(), sizeof(int16_t), s.valueCount, f) == s.valueCount
+            && fread(s.maxs.data(), sizeof(int16_t), s.valueCount, f) == s.valueCount;
+
+        if (ok)
+            catalog[name] = s;
+    }
+
+    fclose(f);
+
+    if (!ok)
+        catalog.clear();
+
+    return ok;
+}
+
+static bool saveCatalog(const std::string& path, const Catalog& catalog)
+{
+    std::string temporary = path + ".tmp";
+    FILE* f = fopen(temporary.c_str(), "wb");
+
+    if (!f)
+        return false;
+
+    fwrite(CATALOG_MAGIC, 1, sizeof(CATALOG_MAGIC), f);
+    put(f, CATALOG_VERSION);
+    put(f, (uint32_t)catalog.size());
+
+    for (const auto& entry : catalog)
+    {
+        const SessionSummary& s = entry.second;
+        put(f, (uint16_t)entry.first.size());
+        fwrite(entry.first.data(), 1, entry.first.size(), f);
+        put(f, s.size); put(f, s.mtime); put(f, s.unreadable);
+        put(f, s.startTime); put(f, s.endTime); put(f, s.samples);
+        put(f, s.hasPosition);
+        put(f, s.minLat); put(f, s.maxLat); put(f, s.minLon); put(f, s.maxLon);
+        put(f, s.maxSpeed); put(f, s.fixTypes); put(f, s.hAccHistogram);
+        put(f, s.valueCount);
+        fwrite(s.mins.data(), sizeof(int16_t), s.valueCount, f);
+        fwrite(s.maxs.data(), sizeof(int16_t), s.valueCount, f);
+    }
+
+    bool ok = fclose(f) == 0;
+
+    //Replace atomically so an interrupted run never leaves a torn index
+    std::error_code error;
+    if (ok)
+        fs::rename(temporary, path, error);
+
+    return ok && !error;
+}
+
+static int indexDirectory(const std::string& directory, const std::string& indexPath, bool pyramids)
+{
+    Catalog previous, catalog;
+    loadCatalog(indexPath, previous);
+
+    int added = 0, unchanged = 0, failed = 0, converted = 0;
+    std::error_code error;
+
+    for (fs::recursive_directory_iterator it(directory, error), end; !error && it != end; it.increment(error))
+    {
+        if (!it->is_regular_file(error))
+            continue;
+
+        std::string extension = it->path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+        if (extension != ".log")
+            continue;
+
+        std::string name = fs::relative(it->path(), directory, error).generic_string();
+        uint64_t size = it->file_size(error);
+        int64_t mtime = it->last_write_time(error).time_since_epoch().count();
+
+        std::string path = it->path().string();
+        auto known = previous.find(name);
+        bool isUnchanged = known != previous.end() && known->second.size == size && known->second.mtime == mtime;
+
+        //Known bad files are neither read again nor reported again
+        if (isUnchanged && known->second.unreadable)
+        {
+            catalog[name] = known->second;
+            unchanged++;
+            continue;
+        }
+
+        std::error_code missing;
+        bool needsPyramid = pyramids && (!isUnchanged || !fs::exists(pyramidPath(path), missing));
+
+        if (isUnchanged && !needsPyramid)
+        {
+            catalog[name] = known->second;
+            unchanged++;
+            continue;
+        }
+
+        //The summary and the pyramid come from a single read of the log
+        SessionSummary summary;
+        PyramidBuilder builder;
+
+        if (!summarize(path, summary, needsPyramid ? &builder : nullptr))
+        {
+            fprintf(stderr, "skipping %s: not a log file\n", name.c_str());
+            summary = SessionSummary();
+            summary.unreadable = 1;
+            failed++;
+        }
+        else
+        {
+            if (needsPyramid)
+            {
+                if (builder.finish(pyramidPath(path)))
+                    converted++;
+                else
+                    fprintf(stderr, "could not write pyramid for %s\n", name.c_str());
+            }
+
+            if (isUnchanged)
+                unchanged++;
+            else
+                added++;
+        }
+
+        summary.size = size;
+        summary.mtime = mtime;
+        catalog[name] = summary;
+    }
+
+    if (error)
+    {
+        fprintf(stderr, "%s: %s\n", directory.c_str(), error.message().c_str());
+        return 1;
+    }
+
+    if (!saveCatalog(indexPath, catalog))
+    {
+        fprintf(stderr, "could not write %s\n", indexPath.c_str());
+        return 1;
+    }
+
+    int removed = 0;
+    for (const auto& entry : previous)
+        if (!catalog.count(entry.first))
+            removed++;
+
+    printf("%d indexed, %d unchanged, %d removed, %d failed, %d pyramids built\n", added, unchanged, removed, failed, converted);
+    return 0;
+}
+
+struct Query {
+    bool hasBox = false;
+    double minLat = 0, minLon = 0, maxLat = 0, maxLon = 0;
+    double minSpeed = 0; //km/h
+    double goodFix = 0; //Share of samples with a 3D fix within maxHAcc
+    double maxHAcc = 2.5; //m
+    int64_t after = -1, before = -1;
+    std::vector<std::string> channels;
+    std::vector<int> channelMins, channelMaxs;
+};
+
+static double goodFixRatio(const SessionSummary& s, double maxHAcc)
+{
+    if (s.samples == 0)
+        return 0;
+
+    uint64_t good = 0;
+    for (uint8_t i = 0; i < HACC_BUCKETS - 1; i++)
+        if (HACC_LIMITS[i] <= maxHAcc * 1000)
+            good += s.hAccHistogram[i];
+
+    return (double)good / s.samples;
+}
+
+static bool matches(const SessionSummary& s, const Query& q)
+{
+    if (s.unreadable)
+        return false;
+
+    if (q.hasBox)
+    {
+        if (!s.hasPosition)
+            return false;
+
+        if (s.maxLat < q.minLat * 1e7 || s.minLat > q.maxLat * 1e7
+            || s.maxLon < q.minLon * 1e7 || s.minLon > q.maxLon * 1e7)
+            return false;
+    }
+
+    if (s.maxSpeed * 0.0036 < q.minSpeed)
+        return false;
+
+    if (q.goodFix > 0 && goodFixRatio(s, q.maxHAcc) < q.goodFix)
+        return false;
+
+    if (q.after >= 0 && s.endTime < q.after)
+        return false;
+
+    if (q.before >= 0 && s.startTime > q.before)
+        return false;
+
+    for (size_t i = 0; i < q.channels.size(); i++)
+    {
+        bool found = false;
+
+        for (uint16_t c = 0; c < s.valueCount && !found; c++)
+        {
+            if (channelName(c) != q.channels[i])
+                continue;
+
+            found = true;
+            //Session range must overlap the requested range
+            if (s.maxs[c] < q.channelMins[i] || s.mins[c] > q.channelMaxs[i])
+                return false;
+        }
+
+        if (!found)
+            return false;
+    }
+
+    return true;
+}
+
+static void printSession(const std::string& name, const SessionSummary& s, double maxHAcc)
+{
+    char start[32];
+    time_t t = s.startTime;
+    strftime(start, sizeof(start), "%Y-%m-%d %H:%M:%S", gmtime(&t));
+
+    printf("%s  %s  %5us  %6.1f km/h  fix %3.0f%%",
+        name.c_str(), start, s.endTime - s.startTime, s.maxSpeed * 0.0036,
+        goodFixRatio(s, maxHAcc) * 100);
+
+    if (s.hasPosition)
+        printf("  [%.5f,%.5f]-[%.5f,%.5f]", s.minLat * 1e-7, s.minLon * 1e-7, s.maxLat * 1e-7, s.maxLon * 1e-7);
+
+    printf("\n");
+}
+
+static void printDetails(const SessionSummary& s)
+{
+    printf("    samples %llu, fixType", (unsigned long long)s.samples);
+    for (uint8_t i = 0; i < FIX_TYPES; i++)
+        printf(" %u:%llu", i, (unsigned long long)s.fixTypes[i]);
+
+    printf(", hAcc <1m:%llu <2.5m:%llu <5m:%llu <10m:%llu more:%llu\n   ",
+        (unsigned long long)s.hAccHistogram[0], (unsigned long long)s.hAccHistogram[1],
+        (unsigned long long)s.hAccHistogram[2], (unsigned long long)s.hAccHistogram[3],
+        (unsigned long long)s.hAccHistogram[4]);
+
+    //An empty log has no channel ranges
+    for (uint16_t c = 0; c < s.valueCount; c++)
+        if (s.samples > 0)
+            printf(" %s:%d..%d", channelName(c).c_str(), s.mins[c], s.maxs[c]);
+        else
+            printf(" %s:n/a", channelName(c).c_str());
+
+    printf("\n");
+}
+
+static int usage()
+{
+    fprintf(stderr,
+        "usage: logcatalog index <dir> [--index <file>] [--no-pyramids]\n"
+        "       logcatalog query <index> [--bbox minLat,minLon,maxLat,maxLon] [--min-speed kmh]\n"
+        "                                [--good-fix ratio] [--max-hacc m] [--after unix] [--before unix]\n"
+        "                                [--channel name:min:max]\n"
+        "       logcatalog show <index>\n");
+    return 2;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+        return usage();
+
+    std::string command = argv[1];
+
+    if (command == "index")
+    {
+        std::string directory = argv[2];
+        std::string indexPath = (fs::path(directory) / "catalog.idx").string();
+        bool pyramids = true;
+
+        for (int i = 3; i < argc; i++)
+        {
+            if (!strcmp(argv[i], "--index") && i + 1 < argc)
+                indexPath = argv[++i];
+            else if (!strcmp(argv[i], "--no-pyramids"))
+                pyramids = false;
+            else
+                return usage();
+        }
+
+        return indexDirectory(directory, indexPath, pyramids);
+    }
+
+    Catalog catalog;
+    if (!loadCatalog(argv[2], catalog))
+    {
+        fprintf(stderr, "could not read index %s\n", argv[2]);
+        return 1;
+    }
+
+    if (command == "show")
+    {
+        for (const auto& entry : catalog)
+        {
+            if (entry.second.unreadable)
+            {
+                printf("%s  not a log file\n", entry.first.c_str());
+                continue;
+            }
+
+            printSession(entry.first, entry.second, 2.5);
+            printDetails(entry.second);
+        }
+        return 0;
+    }
+
+    if (command != "query")
+        return usage();
+
+    Query query;
+
+    for (int i = 3; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+            return usage();
+
+        const char* value = argv[i + 1];
+
+        if (!strcmp(argv[i], "--bbox"))
+        {
+            if (sscanf(value, "%lf,%lf,%lf,%lf", &query.minLat, &query.minLon, &query.maxLat, &query.maxLon) != 4)
+                return usage();
+
+            query.hasBox = true;
+        }
+        else if (!strcmp(argv[i], "--min-speed"))
+            query.minSpeed = atof(value);
+        else if (!strcmp(argv[i], "--good-fix"))
+            query.goodFix = atof(value);
+        else if (!strcmp(argv[i], "--max-hacc"))
+            query.maxHAcc = atof(value);
+        else if (!strcmp(argv[i], "--after"))
+            query.after = atoll(value);
+        else if (!strcmp(argv[i], "--before"))
+            query.before = atoll(value);
+        else if (!strcmp(argv[i], "--channel"))
+        {
+            char name[16];
+            int min = INT16_MIN, max = INT16_MAX;
+            if (sscanf(value, "%15[^:]:%d:%d", name, &min, &max) < 2)
+                return usage();
+
+            query.channels.push_back(name);
+            query.channelMins.push_back(min);
+            query.channelMaxs.push_back(max);
+        }
+        else
+            return usage();
+
+        i++;
+    }
+
+    int count = 0, sessions = 0;
+    for (const auto& entry : catalog)
+    {
+        sessions += !entry.second.unreadable;
+
+        if (!matches(entry.second, query))
+            continue;
+
+        printSession(entry.first, entry.second, query.maxHAcc);
+        count++;
+    }
+
+    fprintf(stderr, "%d of %d sessions\n", count, sessions);
+    return 0;
+}
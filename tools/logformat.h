@@ -0,0 +1,197 @@
+#ifndef LOGFORMAT_H
+#define LOGFORMAT_H
+
+// Host-side reader for the .log files written by datalogger.ino.
+//
+// A file starts with a 10 byte header (micros at open, unix time at open,
+// value count) followed by LogLine records as laid out by avr-gcc: packed,
+// little-endian, 16-bit channel values.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+const uint16_t LOG_HEADER_SIZE = 10;
+const uint16_t LOG_LINE_FIXED_SIZE = 29;
+const uint16_t LOG_MAX_VALUES = 64;
+
+const char* const LOG_CHANNEL_NAMES[] = {
+    "t0", "t1", "t2",
+    "t3", "t4", "t5",
+    "a0", "a1", "a2", "a3",
+    "a4", "a5", "a6", "a7",
+    "lonG", "latG",
+};
+const uint16_t LOG_NAMED_CHANNELS = sizeof(LOG_CHANNEL_NAMES) / sizeof(LOG_CHANNEL_NAMES[0]);
+const uint16_t LOG_LON_G = 14; //milli-g
+const uint16_t LOG_LAT_G = 15; //milli-g
+
+struct LogHeader {
+    uint32_t        micros;
+    uint32_t        unixTime;
+    uint16_t        valueCount;
+};
+
+struct LogSample {
+    uint32_t        micros;
+    uint16_t        speed; //Ground speed, mm/s
+    uint16_t        sAcc; //Speed accuracy estimate
+    int32_t         lon; //Longitude. Scaling: 1e-7
+    int32_t         lat; //Latitude. Scaling: 1e-7
+    int32_t         alt; //Height above mean sea level, mm
+    uint32_t        hAcc; //Horizontal accuracy estimate, mm
+    uint32_t        vAcc; //Vertical accuracy estimate, mm
+    uint8_t         fixType;
+    uint16_t        values[LOG_MAX_VALUES];
+};
+
+inline uint16_t readU16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+inline uint32_t readU32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline std::string channelName(uint16_t channel)
+{
+    if (channel < LOG_NAMED_CHANNELS)
+        return LOG_CHANNEL_NAMES[channel];
+
+    return "v" + std::to_string(channel);
+}
+
+// Temperatures, derived channels and linearized analog inputs are signed;
+// raw analog counts are not, but stay well inside the int16 range.
+inline int32_t channelValue(const LogSample& sample, uint16_t channel)
+{
+    return (int16_t)sample.values[channel];
+}
+
+inline uint16_t logLineSize(uint16_t valueCount)
+{
+    return LOG_LINE_FIXED_SIZE + valueCount * sizeof(uint16_t);
+}
+
+inline void decodeLogLine(const uint8_t* p, uint16_t valueCount, LogSample& sample)
+{
+    sample.micros = readU32(p);
+    sample.speed = readU16(p + 4);
+    sample.sAcc = readU16(p + 6);
+    sample.lon = (int32_t)readU32(p + 8);
+    sample.lat = (int32_t)readU32(p + 12);
+    sample.alt = (int32_t)readU32(p + 16);
+    sample.hAcc = readU32(p + 20);
+    sample.vAcc = readU32(p + 24);
+    sample.fixType = p[28];
+
+    for (uint16_t i = 0; i < valueCount; i++)
+        sample.values[i] = readU16(p + LOG_LINE_FIXED_SIZE + i * 2);
+}
+
+// Sequential, block-buffered reader. A truncated trailing record (card
+// pulled mid-write) is silently dropped.
+class LogReader {
+    FILE* file = nullptr;
+    std::vector<uint8_t> block;
+    size_t blockPos = 0;
+    size_t blockLen = 0;
+    uint16_t lineSize = 0;
+
+    private:
+        bool fill();
+
+    public:
+        LogHeader header = {0, 0, 0};
+
+        ~LogReader() { close(); }
+        bool open(const char path[]);
+        void close();
+        bool next(LogSample& sample);
+        uint16_t recordSize() const { return lineSize; }
+};
+
+inline bool LogReader::open(const char path[])
+{
+    close();
+    file = fopen(path, "rb");
+
+    if (!file)
+        return false;
+
+    uint8_t raw[LOG_HEADER_SIZE];
+
+    if (fread(raw, 1, sizeof(raw), file) != sizeof(raw))
+    {
+        close();
+        return false;
+    }
+
+    header.micros = readU32(raw);
+    header.unixTime = readU32(raw + 4);
+    header.valueCount = readU16(raw + 8);
+
+    if (header.valueCount > LOG_MAX_VALUES)
+    {
+        close();
+        return false;
+    }
+
+    lineSize = logLineSize(header.valueCount);
+    block.resize((size_t)lineSize * 4096);
+    blockPos = blockLen = 0;
+    return true;
+}
+
+inline void LogReader::close()
+{
+    if (file)
+        fclose(file);
+
+    file = nullptr;
+}
+
+inline bool LogReader::fill()
+{
+    size_t remaining = blockLen - blockPos;
+    memmove(block.data(), block.data() + blockPos, remaining);
+    blockLen = remaining + fread(block.data() + remaining, 1, block.size() - remaining, file);
+    blockPos = 0;
+    return blockLen >= lineSize;
+}
+
+inline bool LogReader::next(LogSample& sample)
+{
+    if (!file)
+        return false;
+
+    if (blockLen - blockPos < lineSize && !fill())
+        return false;
+
+    decodeLogLine(block.data() + blockPos, header.valueCount, sample);
+    blockPos += lineSize;
+    return true;
+}
+
+// Micros on the logger wrap every ~71 minutes; this accumulates the
+// elapsed time since the header across wraps.
+class LogClock {
+    uint32_t previous;
+    uint64_t elapsed = 0;
+
+    public:
+        explicit LogClock(const LogHeader& header) : previous(header.micros) {}
+
+        uint64_t update(uint32_t micros)
+        {
+            elapsed += (uint32_t)(micros - previous);
+            previous = micros;
+            return elapsed;
+        }
+};
+
+#endif
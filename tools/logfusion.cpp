@@ -0,0 +1,624 @@
+// GPS/accelerometer fusion for datalogger .log files.
+//
+//   logfusion [-j threads] [--lag seconds] [--out dir]
+//             [--accel-lon channel:zero:mgPerCount] [--accel-lat channel:zero:mgPerCount]
+//             <file.log>...
+//
+// Each LogLine repeats the last GPS solution until the next one arrives. This
+// runs a Kalman filter over every logged sample, using GPS position (weighted
+// by hAcc/vAcc) and ground speed (weighted by sAcc) as measurements and an
+// accelerometer as control input, followed by a fixed-lag
+// Rauch-Tung-Striebel smoother. The result is a smooth position and velocity
+// for every sample, written to <name>.fused.csv.
+//
+// The log holds ground speed but not velN/velE/velD, so horizontal velocity is
+// observed through position and speed, and vertical velocity through altitude.
+// Acceleration comes from analog accelerometer channels given with
+// --accel-lon/--accel-lat; without them the filter runs unaided. The logged
+// lonG/latG channels are not used: the logger derives them from GPS
+// velocity, so feeding them back would count the GPS twice.
+//
+// The smoothing lag is converted to samples using the log's own rate, taken
+// from the median interval between its first samples.
+//
+// Memory is bounded by the smoothing lag; files are processed in parallel.
+//
+// Build: g++ -std=c++17 -O2 -pthread -o logfusion tools/logfusion.cpp
+
+#include "logformat.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <filesystem>
+#include <math.h>
+#include <stdlib.h>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+const double EARTH_RADIUS = 6371000.0;
+const double DEG_TO_RAD = M_PI / 180.0;
+const double G = 9.80665;
+const double MIN_HEADING_SPEED = 1.0; //m/s; below this the heading is unreliable
+const double ACCEL_NOISE_AIDED = 1.0; //m/s^2 process noise with an acceleration input
+const double ACCEL_NOISE_FREE = 4.0; //m/s^2 process noise without one
+const double VERTICAL_ACCEL_NOISE = 1.0;
+const double MIN_ACCURACY = 0.05; //Floor for reported accuracies, m or m/s
+
+template <int R, int C>
+struct Mat {
+    double m[R][C] = {};
+
+    double& operator()(int r, int c) { return m[r][c]; }
+    double operator()(int r, int c) const { return m[r][c]; }
+
+    static Mat identity()
+    {
+        Mat result;
+        for (int i = 0; i < R && i < C; i++)
+            result.m[i][i] = 1;
+        return result;
+    }
+
+    Mat<C, R> transposed() const
+    {
+        Mat<C, R> result;
+        for (int r = 0; r < R; r++)
+            for (int c = 0; c < C; c++)
+                result.m[c][r] = m[r][c];
+        return result;
+    }
+
+    Mat operator+(const Mat& other) const
+    {
+        Mat result;
+        for (int r = 0; r < R; r++)
+            for (int c = 0; c < C; c++)
+                result.m[r][c] = m[r][c] + other.m[r][c];
+        return result;
+    }
+
+    Mat operator-(const Mat& other) const
+    {
+        Mat result;
+        for (int r = 0; r < R; r++)
+            for (int c = 0; c < C; c++)
+                result.m[r][c] = m[r][c] - other.m[r][c];
+        return result;
+    }
+
+    Mat operator*(double s) const
+    {
+        Mat result;
+        for (int r = 0; r < R; r++)
+            for (int c = 0; c < C; c++)
+                result.m[r][c] = m[r][c] * s;
+        return result;
+    }
+};
+
+template <int R, int K, int C>
+static Mat<R, C> operator*(const Mat<R, K>& a, const Mat<K, C>& b)
+{
+    Mat<R, C> result;
+    for (int r = 0; r < R; r++)
+        for (int c = 0; c < C; c++)
+        {
+            double sum = 0;
+            for (int k = 0; k < K; k++)
+                sum += a.m[r][k] * b.m[k][c];
+            result.m[r][c] = sum;
+        }
+    return result;
+}
+
+//Gauss-Jordan with partial pivoting; covariances here are well conditioned
+template <int N>
+static Mat<N, N> inverse(Mat<N, N> a)
+{
+    Mat<N, N> result = Mat<N, N>::identity();
+
+    for (int col = 0; col < N; col++)
+    {
+        int pivot = col;
+        for (int r = col + 1; r < N; r++)
+            if (fabs(a.m[r][col]) > fabs(a.m[pivot][col]))
+                pivot = r;
+
+        std::swap(a.m[col], a.m[pivot]);
+        std::swap(result.m[col], result.m[pivot]);
+
+        double scale = a.m[col][col];
+        if (fabs(scale) < 1e-300)
+            scale = 1e-300;
+
+        for (int c = 0; c < N; c++)
+        {
+            a.m[col][c] /= scale;
+            result.m[col][c] /= scale;
+        }
+
+        for (int r = 0; r < N; r++)
+        {
+            if (r == col)
+                continue;
+
+            double factor = a.m[r][col];
+            for (int c = 0; c < N; c++)
+            {
+                a.m[r][c] -= factor * a.m[col][c];
+                result.m[r][c] -= factor * result.m[col][c];
+            }
+        }
+    }
+
+    return result;
+}
+
+// Scalar measurement update: z = H x + noise(variance)
+template <int N>
+static void update(Mat<N, 1>& x, Mat<N, N>& P, const Mat<1, N>& H, double z, double variance)
+{
+    Mat<N, 1> PHt = P * H.transposed();
+    double S = (H * PHt)(0, 0) + variance;
+    Mat<N, 1> K = PHt * (1.0 / S);
+    double innovation = z - (H * x)(0, 0);
+
+    x = x + K * innovation;
+    P = (Mat<N, N>::identity() - K * H) * P;
+}
+
+// Constant-velocity transition for [p, v] pairs stacked AXES times.
+template <int AXES>
+static Mat<2 * AXES, 2 * AXES> transition(double dt)
+{
+    Mat<2 * AXES, 2 * AXES> F = Mat<2 * AXES, 2 * AXES>::identity();
+    for (int a = 0; a < AXES; a++)
+        F(2 * a, 2 * a + 1) = dt;
+    return F;
+}
+
+template <int AXES>
+static Mat<2 * AXES, 2 * AXES> processNoise(double dt, double sigma)
+{
+    Mat<2 * AXES, 2 * AXES> Q;
+    double q = sigma * sigma;
+    for (int a = 0; a < AXES; a++)
+    {
+        Q(2 * a, 2 * a) = q * dt * dt * dt * dt / 4;
+        Q(2 * a, 2 * a + 1) = Q(2 * a + 1, 2 * a) = q * dt * dt * dt / 2;
+        Q(2 * a + 1, 2 * a + 1) = q * dt * dt;
+    }
+    return Q;
+}
+
+// Horizontal state: [east, vEast, north, vNorth]; vertical: [up, vUp].
+typedef Mat<4, 1> HState;
+typedef Mat<4, 4> HCov;
+typedef Mat<2, 1> VState;
+typedef Mat<2, 2> VCov;
+
+struct Step {
+    uint32_t micros;
+    bool valid; //false until the first fix has initialised the filter
+    HState hPredicted, hFiltered;
+    HCov hPredictedCov, hFilteredCov;
+    VState vPredicted, vFiltered;
+    VCov vPredictedCov, vFilteredCov;
+    HCov hTransition; //Transition from the previous step into this one
+    VCov vTransition;
+};
+
+struct AccelChannel {
+    int channel = -1;
+    double zero = 0;
+    double mgPerCount = 1;
+};
+
+struct Options {
+    double lag = 10.0; //seconds
+    std::string outputDirectory;
+    AccelChannel accelLon, accelLat;
+};
+
+class Fusion {
+    const Options& options;
+    FILE* out;
+
+    bool initialised = false;
+    double lat0 = 0, lon0 = 0, cosLat0 = 1;
+    HState hx;
+    HCov hP;
+    VState vx;
+    VCov vP;
+
+    LogSample lastGps = {};
+    bool hasLastGps = false;
+    uint32_t previousMicros = 0;
+    bool hasPrevious = false;
+
+    std::deque<Step> window;
+    size_t lagSteps;
+
+    private:
+        bool isNewSolution(const LogSample& sample);
+        bool acceleration(const LogSample& sample, uint16_t valueCount, double& east, double& north);
+        void smoothAndEmit(size_t count);
+        void emit(const Step& step, const HState& h, const VState& v, const HCov& hCov);
+
+    public:
+        Fusion(const Options& options, FILE* out, double sampleRate)
+            : options(options), out(out), lagSteps((size_t)(options.lag * sampleRate)) {}
+
+        void add(const LogSample& sample, uint16_t valueCount);
+        void finish();
+};
+
+bool Fusion::isNewSolution(const LogSample& s)
+{
+    if (s.fixType < 2 || s.fixType > 4)
+        return false;
+
+    if (!hasLastGps)
+        return true;
+
+    const LogSample& p = lastGps;
+    return s.lat != p.lat || s.lon != p.lon || s.alt != p.alt || s.hAcc != p.hAcc
+        || s.vAcc != p.vAcc || s.speed != p.speed || s.sAcc != p.sAcc;
+}
+
+bool Fusion::acceleration(const LogSample& s, uint16_t valueCount, double& east, double& north)
+{
+    double lon, lat;
+
+    if (options.accelLon.channel >= 0 && options.accelLat.channel >= 0)
+    {
+        if (options.accelLon.channel >= valueCount || options.accelLat.channel >= valueCount)
+            return false;
+
+        lon = (s.values[options.accelLon.channel] - options.accelLon.zero) * options.accelLon.mgPerCount;
+        lat = (s.values[options.accelLat.channel] - options.accelLat.zero) * options.accelLat.mgPerCount;
+    }
+    else
+        return false;
+
+    //Body frame follows the direction of travel
+    double ve = hx(1, 0), vn = hx(3, 0);
+    double speed = sqrt(ve * ve + vn * vn);
+
+    if (speed < MIN_HEADING_SPEED)
+        return false;
+
+    double fe = ve / speed, fn = vn / speed;
+    lon *= G / 1000;
+    lat *= G / 1000;
+
+    //Right-hand normal of (fe, fn) is (fn, -fe)
+    east = lon * fe + lat * fn;
+    north = lon * fn - lat * fe;
+    return true;
+}
+
+void Fusion::add(const LogSample& s, uint16_t valueCount)
+{
+    Step step = {};
+    step.micros = s.micros;
+
+    double dt = hasPrevious ? (uint32_t)(s.micros - previousMicros) * 1e-6 : 0;
+    previousMicros = s.micros;
+    hasPrevious = true;
+
+    bool newSolution = isNewSolution(s);
+
+    if (!initialised && newSolution)
+    {
+        lat0 = s.lat * 1e-7;
+        lon0 = s.lon * 1e-7;
+        cosLat0 = cos(lat0 * DEG_TO_RAD);
+
+        double hSigma = std::max(s.hAcc * 1e-3, MIN_ACCURACY);
+        double vSigma = std::max(s.vAcc * 1e-3, MIN_ACCURACY);
+
+        hx = HState();
+        hP = HCov();
+        hP(0, 0) = hP(2, 2) = hSigma * hSigma;
+        hP(1, 1) = hP(3, 3) = 100; //Unknown direction of travel
+
+        vx = VState();
+        vx(0, 0) = s.alt * 1e-3;
+        vP = VCov();
+        vP(0, 0) = vSigma * vSigma;
+        vP(1, 1) = 4;
+
+        initialised = true;
+        dt = 0;
+    }
+
+    if (initialised)
+    {
+        //Predict
+        double ae = 0, an = 0;
+        bool aided = acceleration(s, valueCount, ae, an);
+
+        HCov F = transition<2>(dt);
+        hx = F * hx;
+        hx(0, 0) += 0.5 * ae * dt * dt;
+        hx(1, 0) += ae * dt;
+        hx(2, 0) += 0.5 * an * dt * dt;
+        hx(3, 0) += an * dt;
+        hP = F * hP * F.transposed() + processNoise<2>(dt, aided ? ACCEL_NOISE_AIDED : ACCEL_NOISE_FREE);
+
+        VCov Fv = transition<1>(dt);
+        vx = Fv * vx;
+        vP = Fv * vP * Fv.transposed() + processNoise<1>(dt, VERTICAL_ACCEL_NOISE);
+
+        step.valid = true;
+        step.hTransition = F;
+        step.vTransition = Fv;
+        step.hPredicted = hx;
+        step.hPredictedCov = hP;
+        step.vPredicted = vx;
+        step.vPredictedCov = vP;
+
+        //Correct with a fresh GPS solution
+        if (newSolution)
+        {
+            double east = (s.lon * 1e-7 - lon0) * DEG_TO_RAD * EARTH_RADIUS * cosLat0;
+            double north = (s.lat * 1e-7 - lat0) * DEG_TO_RAD * EARTH_RADIUS;
+            double hSigma = std::max(s.hAcc * 1e-3, MIN_ACCURACY);
+            double vSigma = std::max(s.vAcc * 1e-3, MIN_ACCURACY);
+            double sSigma = std::max(s.sAcc * 1e-3, MIN_ACCURACY);
+
+            Mat<1, 4> H;
+            H(0, 0) = 1;
+            update(hx, hP, H, east, hSigma * hSigma);
+
+            H = Mat<1, 4>();
+            H(0, 2) = 1;
+            update(hx, hP, H, north, hSigma * hSigma);
+
+            //Ground speed constrains velocity along the current heading
+            double ve = hx(1, 0), vn = hx(3, 0);
+            double speed = sqrt(ve * ve + vn * vn);
+            if (speed > MIN_HEADING_SPEED)
+            {
+                H = Mat<1, 4>();
+                H(0, 1) = ve / speed;
+                H(0, 3) = vn / speed;
+                update(hx, hP, H, s.speed * 1e-3, sSigma * sSigma);
+            }
+
+            Mat<1, 2> Hv;
+            Hv(0, 0) = 1;
+            update(vx, vP, Hv, s.alt * 1e-3, vSigma * vSigma);
+
+            lastGps = s;
+            hasLastGps = true;
+        }
+
+        step.hFiltered = hx;
+        step.hFilteredCov = hP;
+        step.vFiltered = vx;
+        step.vFilteredCov = vP;
+    }
+
+    window.push_back(step);
+
+    //Smooth over twice the lag, emit the older half
+    if (window.size() >= 2 * lagSteps + 1)
+        smoothAndEmit(window.size() - lagSteps);
+}
+
+void Fusion::emit(const Step& step, const HState& h, const VState& v, const HCov& hCov)
+{
+    if (!step.valid)
+    {
+        fprintf(out, "%u,nan,nan,nan,nan,nan,nan,nan\n", step.micros);
+        return;
+    }
+
+    double lat = lat0 + h(2, 0) / EARTH_RADIUS / DEG_TO_RAD;
+    double lon = lon0 + h(0, 0) / (EARTH_RADIUS * cosLat0) / DEG_TO_RAD;
+    double sigma = sqrt(std::max(0.0, hCov(0, 0) + hCov(2, 2)));
+
+    fprintf(out, "%u,%.8f,%.8f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+        step.micros, lat, lon, v(0, 0), h(3, 0), h(1, 0), -v(1, 0), sigma);
+}
+
+// Runs the RTS smoother backwards over the whole window, seeded with the
+// filtered estimate of the newest step, and writes out the oldest count steps.
+void Fusion::smoothAndEmit(size_t count)
+{
+    size_t n = window.size();
+    std::vector<HState> hs(n);
+    std::vector<VState> vs(n);
+    std::vector<HCov> hc(n);
+
+    hs[n - 1] = window[n - 1].hFiltered;
+    vs[n - 1] = window[n - 1].vFiltered;
+    hc[n - 1] = window[n - 1].hFilteredCov;
+
+    for (size_t k = n - 1; k-- > 0;)
+    {
+        const Step& current = window[k];
+        const Step& next = window[k + 1];
+
+        if (!current.valid || !next.valid)
+        {
+            hs[k] = current.hFiltered;
+            vs[k] = current.vFiltered;
+            hc[k] = current.hFilteredCov;
+            continue;
+        }
+
+        HCov C = current.hFilteredCov * next.hTransition.transposed() * inverse(next.hPredictedCov);
+        hs[k] = current.hFiltered + C * (hs[k + 1] - next.hPredicted);
+        hc[k] = current.hFilteredCov + C * (hc[k + 1] - next.hPredictedCov) * C.transposed();
+
+        VCov Cv = current.vFilteredCov * next.vTransition.transposed() * inverse(next.vPredictedCov);
+        vs[k] = current.vFiltered + Cv * (vs[k + 1] - next.vPredicted);
+    }
+
+    for (size_t k = 0; k < count; k++)
+        emit(window[k], hs[k], vs[k], hc[k]);
+
+    window.erase(window.begin(), window.begin() + count);
+}
+
+void Fusion::finish()
+{
+    if (!window.empty())
+        smoothAndEmit(window.size());
+}
+
+// Samples per second from the median interval over the first samples, or the
+// logger's default 4 ms tick if the file is too short to tell.
+static double sampleRate(const std::string& path)
+{
+    const size_t maxIntervals = 1000;
+
+    LogReader reader;
+    LogSample sample;
+    std::vector<uint32_t> intervals;
+    uint32_t previous = 0;
+    bool hasPrevious = false;
+
+    if (reader.open(path.c_str()))
+    {
+        while (intervals.size() < maxIntervals && reader.next(sample))
+        {
+            if (hasPrevious)
+                intervals.push_back(sample.micros - previous);
+
+            previous = sample.micros;
+            hasPrevious = true;
+        }
+    }
+
+    if (intervals.empty())
+        return 250;
+
+    std::nth_element(intervals.begin(), intervals.begin() + intervals.size() / 2, intervals.end());
+    uint32_t median = intervals[intervals.size() / 2];
+
+    return median > 0 ? 1e6 / median : 250;
+}
+
+static bool fuseFile(const std::string& path, const Options& options)
+{
+    LogReader reader;
+    if (!reader.open(path.c_str()))
+    {
+        fprintf(stderr, "%s: not a log file\n", path.c_str());
+        return false;
+    }
+
+    fs::path output = fs::path(path).replace_extension(".fused.csv");
+    if (!options.outputDirectory.empty())
+        output = fs::path(options.outputDirectory) / output.filename();
+
+    FILE* out = fopen(output.string().c_str(), "w");
+    if (!out)
+    {
+        fprintf(stderr, "%s: could not write\n", output.string().c_str());
+        return false;
+    }
+
+    fprintf(out, "micros,lat,lon,alt,velN,velE,velD,hSigma\n");
+
+    Fusion fusion(options, out, sampleRate(path));
+    LogSample sample;
+    uint64_t samples = 0;
+
+    while (reader.next(sample))
+    {
+        fusion.add(sample, reader.header.valueCount);
+        samples++;
+    }
+
+    fusion.finish();
+    fclose(out);
+
+    printf("%s: %llu samples -> %s\n", path.c_str(), (unsigned long long)samples, output.string().c_str());
+    return true;
+}
+
+static bool parseAccel(const char* value, AccelChannel& accel)
+{
+    char name[16];
+    if (sscanf(value, "%15[^:]:%lf:%lf", name, &accel.zero, &accel.mgPerCount) != 3)
+        return false;
+
+    for (uint16_t c = 0; c < LOG_MAX_VALUES; c++)
+        if (channelName(c) == name)
+            accel.channel = c;
+
+    //Derived from GPS velocity, see the top of the file
+    if (accel.channel == LOG_LON_G || accel.channel == LOG_LAT_G)
+        return false;
+
+    return accel.channel >= 0;
+}
+
+static int usage()
+{
+    fprintf(stderr,
+        "usage: logfusion [-j threads] [--lag seconds] [--out dir]\n"
+        "                 [--accel-lon channel:zero:mgPerCount] [--accel-lat channel:zero:mgPerCount]\n"
+        "                 <file.log>...\n");
+    return 2;
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+
+        if (!strcmp(argv[i], "-j") && hasValue)
+            threads = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--lag") && hasValue)
+            options.lag = std::max(0.1, atof(argv[++i]));
+        else if (!strcmp(argv[i], "--out") && hasValue)
+            options.outputDirectory = argv[++i];
+        else if (!strcmp(argv[i], "--accel-lon") && hasValue)
+        {
+            if (!parseAccel(argv[++i], options.accelLon))
+                return usage();
+        }
+        else if (!strcmp(argv[i], "--accel-lat") && hasValue)
+        {
+            if (!parseAccel(argv[++i], options.accelLat))
+                return usage();
+        }
+        else if (argv[i][0] == '-')
+            return usage();
+        else
+            files.push_back(argv[i]);
+    }
+
+    if (files.empty())
+        return usage();
+
+    //One session per worker; sessions are independent
+    std::atomic<size_t> next(0);
+    std::atomic<int> failures(0);
+    std::vector<std::thread> workers;
+
+    for (unsigned t = 0; t < std::min<size_t>(threads, files.size()); t++)
+        workers.emplace_back([&]() {
+            for (size_t i = next++; i < files.size(); i = next++)
+                if (!fuseFile(files[i], options))
+                    failures++;
+        });
+
+    for (std::thread& worker : workers)
+        worker.join();
+
+    return failures > 0 ? 1 : 0;
+}
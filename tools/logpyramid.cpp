@@ -0,0 +1,177 @@
+// Builds and queries level-of-detail pyramids (see pyramid.h) for .log files.
+//
+//   logpyramid build <file.log>...
+//   logpyramid info <file.lod>
+//   logpyramid query <file.lod> [--from s] [--to s] [--bbox minLat,minLon,maxLat,maxLon]
+//                               [--points n] [--channel name]...
+//
+// A query prints at most --points records (default 2000) as CSV, from the
+// finest level that fits the requested time window and map area. logcatalog
+// keeps the pyramids of an archive up to date while indexing.
+//
+// Build: g++ -std=c++17 -O2 -o logpyramid tools/logpyramid.cpp
+
+#include "pyramid.h"
+
+#include <stdlib.h>
+
+static int build(int argc, char* argv[])
+{
+    int failed = 0;
+
+    for (int i = 2; i < argc; i++)
+    {
+        std::string output = pyramidPath(argv[i]);
+
+        if (!buildPyramid(argv[i], output))
+        {
+            fprintf(stderr, "%s: could not build pyramid\n", argv[i]);
+            failed++;
+            continue;
+        }
+
+        printf("%s -> %s\n", argv[i], output.c_str());
+    }
+
+    return failed > 0 ? 1 : 0;
+}
+
+static int info(const Pyramid& pyramid)
+{
+    const PyramidHeader& h = pyramid.header;
+
+    printf("%llu samples, %u channels, unix time %u, %u levels\n",
+        (unsigned long long)h.samples, h.valueCount, h.unixTime, h.levelCount);
+
+    for (uint16_t level = 0; level < h.levelCount; level++)
+        printf("  level %2u: %10llu records, %8llu samples each\n", level,
+            (unsigned long long)pyramid.levels[level].count,
+            (unsigned long long)pyramid.levels[level].samplesPerRecord);
+
+    return 0;
+}
+
+static int usage()
+{
+    fprintf(stderr,
+        "usage: logpyramid build <file.log>...\n"
+        "       logpyramid info <file.lod>\n"
+        "       logpyramid query <file.lod> [--from s] [--to s] [--bbox minLat,minLon,maxLat,maxLon]\n"
+        "                                   [--points n] [--channel name]...\n");
+    return 2;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+        return usage();
+
+    std::string command = argv[1];
+
+    if (command == "build")
+        return build(argc, argv);
+
+    Pyramid pyramid;
+    if (!pyramid.open(argv[2]))
+    {
+        fprintf(stderr, "could not read pyramid %s\n", argv[2]);
+        return 1;
+    }
+
+    if (command == "info")
+        return info(pyramid);
+
+    if (command != "query")
+        return usage();
+
+    uint64_t from = 0, to = UINT64_MAX;
+    bool hasBox = false;
+    double minLat = 0, minLon = 0, maxLat = 0, maxLon = 0;
+    size_t points = 2000;
+    std::vector<uint16_t> channels;
+
+    for (int i = 3; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+            return usage();
+
+        const char* value = argv[i + 1];
+
+        if (!strcmp(argv[i], "--from"))
+            from = (uint64_t)(atof(value) * 1e6);
+        else if (!strcmp(argv[i], "--to"))
+            to = (uint64_t)(atof(value) * 1e6);
+        else if (!strcmp(argv[i], "--bbox"))
+        {
+            if (sscanf(value, "%lf,%lf,%lf,%lf", &minLat, &minLon, &maxLat, &maxLon) != 4)
+                return usage();
+
+            hasBox = true;
+        }
+        else if (!strcmp(argv[i], "--points"))
+            points = std::max(1, atoi(value));
+        else if (!strcmp(argv[i], "--channel"))
+        {
+            bool found = false;
+
+            for (uint16_t c = 0; c < pyramid.header.valueCount && !found; c++)
+                if (channelName(c) == value)
+                {
+                    channels.push_back(c);
+                    found = true;
+                }
+
+            if (!found)
+            {
+                fprintf(stderr, "unknown channel %s\n", value);
+                return 1;
+            }
+        }
+        else
+            return usage();
+
+        i++;
+    }
+
+    //Without --channel, every channel is printed
+    if (channels.empty())
+        for (uint16_t c = 0; c < pyramid.header.valueCount; c++)
+            channels.push_back(c);
+
+    PyramidBox box = {
+        (int32_t)(minLat * 1e7), (int32_t)(minLon * 1e7),
+        (int32_t)(maxLat * 1e7), (int32_t)(maxLon * 1e7),
+    };
+
+    std::vector<uint64_t> indices;
+    int level = pyramid.select(from, to, hasBox ? &box : nullptr, points, indices);
+
+    printf("start,end,samples,maxSpeed,minLat,minLon,maxLat,maxLon,lat0,lon0,lat1,lon1,lat2,lon2");
+    for (uint16_t c : channels)
+        printf(",%smin,%smax", channelName(c).c_str(), channelName(c).c_str());
+    printf("\n");
+
+    for (uint64_t index : indices)
+    {
+        const PyramidRecord& r = pyramid.record(level, index);
+
+        printf("%.3f,%.3f,%u,%u", r.start * 1e-6, r.end * 1e-6, r.samples, r.maxSpeed);
+
+        if (r.hasPosition)
+        {
+            printf(",%.7f,%.7f,%.7f,%.7f", r.minLat * 1e-7, r.minLon * 1e-7, r.maxLat * 1e-7, r.maxLon * 1e-7);
+            for (uint8_t p = 0; p < POINT_COUNT; p++)
+                printf(",%.7f,%.7f", r.lat[p] * 1e-7, r.lon[p] * 1e-7);
+        }
+        else
+            printf(",,,,,,,,,,");
+
+        for (uint16_t c : channels)
+            printf(",%d,%d", pyramid.min(r, c), pyramid.max(r, c));
+
+        printf("\n");
+    }
+
+    fprintf(stderr, "level %d, %d records\n", level, (int)indices.size());
+    return 0;
+}
@@ -0,0 +1,571 @@
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+// Level-of-detail pyramid for .log files, written next to the log as .lod.
+//
+// Level 0 aggregates PYRAMID_BASE_SAMPLES consecutive samples per record,
+// every level above aggregates PYRAMID_FACTOR records of the level below, up
+// to a single record for the whole session. Each record keeps the time span,
+// the min/max of every channel and of speed, the position bounding box and
+// three track points (first, last and the point furthest from the chord
+// between them), so both plots and track maps can be drawn from any level.
+//
+// Layout: PyramidHeader, levelCount PyramidLevel entries, then the records of
+// each level. A record is a PyramidRecord followed by valueCount int16 mins
+// and valueCount int16 maxs. Everything is packed little-endian so the file
+// can be memory-mapped as is.
+
+#include "logformat.h"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <filesystem>
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char PYRAMID_MAGIC[8] = { 'D', 'L', 'P', 'Y', 'R', 'M', 'D', 0 };
+const uint16_t PYRAMID_VERSION = 1;
+const uint32_t PYRAMID_BASE_SAMPLES = 8; //32 ms at the 4 ms log interval
+const uint32_t PYRAMID_FACTOR = 4;
+const uint16_t PYRAMID_MAX_LEVELS = 32;
+
+enum PyramidPointIndex {
+    POINT_FIRST = 0,
+    POINT_EXTREME = 1,
+    POINT_LAST = 2,
+    POINT_COUNT = 3,
+};
+
+#pragma pack(push, 1)
+struct PyramidHeader {
+    char            magic[8];
+    uint16_t        version;
+    uint16_t        valueCount;
+    uint16_t        recordSize;
+    uint16_t        levelCount;
+    uint32_t        factor;
+    uint32_t        baseSamples;
+    uint32_t        unixTime; //From the log header
+    uint32_t        reserved;
+    uint64_t        samples;
+};
+
+struct PyramidLevel {
+    uint64_t        offset; //From the start of the file
+    uint64_t        count;
+    uint64_t        samplesPerRecord;
+};
+
+struct PyramidRecord {
+    uint64_t        start; //Elapsed micros since the log header, first sample
+    uint64_t        end; //Last sample
+    uint32_t        samples;
+    uint16_t        maxSpeed; //mm/s
+    uint8_t         hasPosition; //Any sample with a 2D/3D fix
+    uint8_t         reserved;
+    int32_t         minLat, maxLat, minLon, maxLon;
+    int32_t         lat[POINT_COUNT];
+    int32_t         lon[POINT_COUNT];
+};
+#pragma pack(pop)
+
+static_assert(sizeof(PyramidHeader) == 40, "PyramidHeader layout");
+static_assert(sizeof(PyramidLevel) == 24, "PyramidLevel layout");
+static_assert(sizeof(PyramidRecord) == 64, "PyramidRecord layout");
+
+inline uint16_t pyramidRecordSize(uint16_t valueCount)
+{
+    return sizeof(PyramidRecord) + 2 * valueCount * sizeof(int16_t);
+}
+
+inline std::string pyramidPath(const std::string& logPath)
+{
+    return std::filesystem::path(logPath).replace_extension(".lod").string();
+}
+
+// Streams samples into all levels at once. Each level keeps one open bucket
+// and spools finished records to a temporary file, so memory does not grow
+// with the session length.
+class PyramidBuilder {
+    struct Point {
+        int32_t lat, lon;
+    };
+
+    struct Bucket {
+        PyramidRecord record;
+        int16_t mins[LOG_MAX_VALUES];
+        int16_t maxs[LOG_MAX_VALUES];
+        uint32_t members; //Samples on level 0, records of the level below otherwise
+        std::vector<Point> candidates; //For the extreme point
+    };
+
+    struct Level {
+        Bucket bucket;
+        FILE* spool = nullptr;
+        uint64_t count = 0;
+    };
+
+    LogHeader logHeader = {0, 0, 0};
+    uint64_t samples = 0;
+    std::vector<Level> levels;
+    std::vector<uint8_t> encoded;
+
+    private:
+        void resetBucket(Bucket& bucket);
+        void addPoint(Bucket& bucket, int32_t lat, int32_t lon);
+        void closeBucket(Bucket& bucket);
+        void merge(Bucket& parent, const Bucket& child);
+        bool addLevel();
+        void write(uint16_t level);
+        void emit(uint16_t level);
+        void discard();
+
+    public:
+        ~PyramidBuilder() { discard(); }
+        void begin(const LogHeader& header);
+        void add(const LogSample& sample, uint64_t elapsed);
+        bool finish(const std::string& path);
+};
+
+inline void PyramidBuilder::resetBucket(Bucket& bucket)
+{
+    bucket.record = PyramidRecord();
+    bucket.members = 0;
+    bucket.candidates.clear();
+
+    for (uint16_t i = 0; i < logHeader.valueCount; i++)
+    {
+        bucket.mins[i] = INT16_MAX;
+        bucket.maxs[i] = INT16_MIN;
+    }
+}
+
+inline void PyramidBuilder::addPoint(Bucket& bucket, int32_t lat, int32_t lon)
+{
+    PyramidRecord& r = bucket.record;
+
+    if (!r.hasPosition)
+    {
+        r.minLat = r.maxLat = lat;
+        r.minLon = r.maxLon = lon;
+        r.lat[POINT_FIRST] = lat;
+        r.lon[POINT_FIRST] = lon;
+        r.hasPosition = 1;
+    }
+    else
+    {
+        r.minLat = std::min(r.minLat, lat);
+        r.maxLat = std::max(r.maxLat, lat);
+        r.minLon = std::min(r.minLon, lon);
+        r.maxLon = std::max(r.maxLon, lon);
+    }
+
+    r.lat[POINT_LAST] = lat;
+    r.lon[POINT_LAST] = lon;
+    bucket.candidates.push_back({ lat, lon });
+}
+
+// Picks the candidate furthest from the first-last chord, i.e. one step of
+// Douglas-Peucker per record. Longitude is scaled to match latitude distances.
+inline void PyramidBuilder::closeBucket(Bucket& bucket)
+{
+    PyramidRecord& r = bucket.record;
+
+    if (!r.hasPosition)
+        return;
+
+    double scale = cos(r.lat[POINT_FIRST] * 1e-7 * M_PI / 180);
+    double x0 = r.lon[POINT_FIRST] * scale, y0 = r.lat[POINT_FIRST];
+    double dx = r.lon[POINT_LAST] * scale - x0, dy = r.lat[POINT_LAST] - y0;
+    double chord = sqrt(dx * dx + dy * dy);
+    double furthest = -1;
+
+    for (const Point& p : bucket.candidates)
+    {
+        double px = p.lon * scale - x0, py = p.lat - y0;
+        double distance = chord > 0 ? fabs(px * dy - py * dx) / chord : sqrt(px * px + py * py);
+
+        if (distance > furthest)
+        {
+            furthest = distance;
+            r.lat[POINT_EXTREME] = p.lat;
+            r.lon[POINT_EXTREME] = p.lon;
+        }
+    }
+}
+
+inline void PyramidBuilder::merge(Bucket& parent, const Bucket& child)
+{
+    PyramidRecord& r = parent.record;
+    const PyramidRecord& c = child.record;
+
+    if (parent.members == 0)
+        r.start = c.start;
+
+    r.end = c.end;
+    r.samples += c.samples;
+    r.maxSpeed = std::max(r.maxSpeed, c.maxSpeed);
+
+    for (uint16_t i = 0; i < logHeader.valueCount; i++)
+    {
+        parent.mins[i] = std::min(parent.mins[i], child.mins[i]);
+        parent.maxs[i] = std::max(parent.maxs[i], child.maxs[i]);
+    }
+
+    if (c.hasPosition)
+    {
+        addPoint(parent, c.lat[POINT_FIRST], c.lon[POINT_FIRST]);
+        addPoint(parent, c.lat[POINT_EXTREME], c.lon[POINT_EXTREME]);
+        addPoint(parent, c.lat[POINT_LAST], c.lon[POINT_LAST]);
+
+        r.minLat = std::min(r.minLat, c.minLat);
+        r.maxLat = std::max(r.maxLat, c.maxLat);
+        r.minLon = std::min(r.minLon, c.minLon);
+        r.maxLon = std::max(r.maxLon, c.maxLon);
+    }
+
+    parent.members++;
+}
+
+inline bool PyramidBuilder::addLevel()
+{
+    if (levels.size() >= PYRAMID_MAX_LEVELS)
+        return false;
+
+    levels.emplace_back();
+    levels.back().spool = tmpfile();
+    resetBucket(levels.back().bucket);
+    return levels.back().spool != nullptr;
+}
+
+inline void PyramidBuilder::write(uint16_t level)
+{
+    Level& l = levels[level];
+    Bucket& bucket = l.bucket;
+    uint16_t valueCount = logHeader.valueCount;
+
+    closeBucket(bucket);
+
+    encoded.resize(pyramidRecordSize(valueCount));
+    memcpy(encoded.data(), &bucket.record, sizeof(PyramidRecord));
+    memcpy(encoded.data() + sizeof(PyramidRecord), bucket.mins, valueCount * sizeof(int16_t));
+    memcpy(encoded.data() + sizeof(PyramidRecord) + valueCount * sizeof(int16_t), bucket.maxs, valueCount * sizeof(int16_t));
+
+    fwrite(encoded.data(), 1, encoded.size(), l.spool);
+    l.count++;
+}
+
+// Writes the open bucket of a level and folds it into the level above.
+inline void PyramidBuilder::emit(uint16_t level)
+{
+    write(level);
+
+    if (level + 1 < (int)levels.size() || addLevel())
+    {
+        Level& parent = levels[level + 1];
+        merge(parent.bucket, levels[level].bucket);
+
+        if (parent.bucket.members == PYRAMID_FACTOR)
+            emit(level + 1);
+    }
+
+    resetBucket(levels[level].bucket);
+}
+
+inline void PyramidBuilder::discard()
+{
+    for (Level& level : levels)
+        if (level.spool)
+            fclose(level.spool);
+
+    levels.clear();
+}
+
+inline void PyramidBuilder::begin(const LogHeader& header)
+{
+    discard();
+    logHeader = header;
+    samples = 0;
+    addLevel();
+}
+
+inline void PyramidBuilder::add(const LogSample& sample, uint64_t elapsed)
+{
+    Bucket& bucket = levels[0].bucket;
+    PyramidRecord& r = bucket.record;
+
+    if (bucket.members == 0)
+        r.start = elapsed;
+
+    r.end = elapsed;
+    r.samples++;
+
+    for (uint16_t i = 0; i < logHeader.valueCount; i++)
+    {
+        int16_t value = channelValue(sample, i);
+        bucket.mins[i] = std::min(bucket.mins[i], value);
+        bucket.maxs[i] = std::max(bucket.maxs[i], value);
+    }
+
+    if (sample.fixType >= 2 && sample.fixType <= 4)
+    {
+        r.maxSpeed = std::max(r.maxSpeed, sample.speed);
+        addPoint(bucket, sample.lat, sample.lon);
+    }
+
+    bucket.members++;
+    samples++;
+
+    if (bucket.members == PYRAMID_BASE_SAMPLES)
+        emit(0);
+}
+
+// Flushes the partial buckets, collapsing to a single top record, and writes
+// the file through a temporary so readers never map a half-written pyramid.
+inline bool PyramidBuilder::finish(const std::string& path)
+{
+    for (uint16_t level = 0; level < levels.size(); level++)
+    {
+        if (levels[level].bucket.members == 0)
+            continue;
+
+        bool isTop = levels[level].count == 0 && level + 1 == (int)levels.size();
+
+        if (isTop)
+            write(level);
+        else
+            emit(level);
+    }
+
+    //A record-less level can only be left at the top of an empty log
+    while (!levels.empty() && levels.back().count == 0)
+    {
+        fclose(levels.back().spool);
+        levels.pop_back();
+    }
+
+    PyramidHeader header = {};
+    memcpy(header.magic, PYRAMID_MAGIC, sizeof(PYRAMID_MAGIC));
+    header.version = PYRAMID_VERSION;
+    header.valueCount = logHeader.valueCount;
+    header.recordSize = pyramidRecordSize(logHeader.valueCount);
+    header.levelCount = levels.size();
+    header.factor = PYRAMID_FACTOR;
+    header.baseSamples = PYRAMID_BASE_SAMPLES;
+    header.unixTime = logHeader.unixTime;
+    header.samples = samples;
+
+    std::string temporary = path + ".tmp";
+    FILE* out = fopen(temporary.c_str(), "wb");
+
+    if (!out)
+        return false;
+
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+    uint64_t offset = sizeof(header) + levels.size() * sizeof(PyramidLevel);
+    uint64_t samplesPerRecord = PYRAMID_BASE_SAMPLES;
+
+    for (const Level& l : levels)
+    {
+        PyramidLevel entry = { offset, l.count, samplesPerRecord };
+        ok = ok && fwrite(&entry, sizeof(entry), 1, out) == 1;
+        offset += l.count * header.recordSize;
+        samplesPerRecord *= PYRAMID_FACTOR;
+    }
+
+    char block[65536];
+    for (Level& l : levels)
+    {
+        rewind(l.spool);
+        size_t n;
+        while (ok && (n = fread(block, 1, sizeof(block), l.spool)) > 0)
+            ok = fwrite(block, 1, n, out) == n;
+    }
+
+    ok = fclose(out) == 0 && ok;
+    discard();
+
+    std::error_code error;
+    if (ok)
+        std::filesystem::rename(temporary, path, error);
+    else
+        std::filesystem::remove(temporary, error);
+
+    return ok && !error;
+}
+
+inline bool buildPyramid(const std::string& logPath, const std::string& pyramidPath)
+{
+    LogReader reader;
+
+    if (!reader.open(logPath.c_str()))
+        return false;
+
+    LogClock clock(reader.header);
+    LogSample sample;
+    PyramidBuilder builder;
+
+    builder.begin(reader.header);
+
+    while (reader.next(sample))
+        builder.add(sample, clock.update(sample.micros));
+
+    return builder.finish(pyramidPath);
+}
+
+struct PyramidBox {
+    int32_t minLat, minLon, maxLat, maxLon;
+};
+
+// Read-only, memory-mapped view of a .lod file.
+class Pyramid {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    private:
+        bool intersects(const PyramidRecord& record, uint64_t from, uint64_t to, const PyramidBox* box) const;
+
+    public:
+        PyramidHeader header = {};
+        const PyramidLevel* levels = nullptr;
+
+        ~Pyramid() { close(); }
+        bool open(const char path[]);
+        void close();
+        const PyramidRecord& record(uint16_t level, uint64_t index) const;
+        int16_t min(const PyramidRecord& record, uint16_t channel) const;
+        int16_t max(const PyramidRecord& record, uint16_t channel) const;
+        int select(uint64_t from, uint64_t to, const PyramidBox* box, size_t maxRecords, std::vector<uint64_t>& indices) const;
+};
+
+inline bool Pyramid::open(const char path[])
+{
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(PyramidHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (mapped == MAP_FAILED)
+        return false;
+
+    data = (const uint8_t*)mapped;
+    size = info.st_size;
+    memcpy(&header, data, sizeof(header));
+
+    bool ok = memcmp(header.magic, PYRAMID_MAGIC, sizeof(PYRAMID_MAGIC)) == 0
+        && header.version == PYRAMID_VERSION
+        && header.valueCount <= LOG_MAX_VALUES
+        && header.recordSize == pyramidRecordSize(header.valueCount)
+        && header.levelCount <= PYRAMID_MAX_LEVELS
+        && sizeof(header) + header.levelCount * sizeof(PyramidLevel) <= size;
+
+    levels = (const PyramidLevel*)(data + sizeof(header));
+
+    for (uint16_t i = 0; ok && i < header.levelCount; i++)
+        ok = levels[i].offset + levels[i].count * header.recordSize <= size;
+
+    if (!ok)
+        close();
+
+    return ok;
+}
+
+inline void Pyramid::close()
+{
+    if (data)
+        munmap((void*)data, size);
+
+    data = nullptr;
+    levels = nullptr;
+    size = 0;
+    header = PyramidHeader();
+}
+
+inline const PyramidRecord& Pyramid::record(uint16_t level, uint64_t index) const
+{
+    return *(const PyramidRecord*)(data + levels[level].offset + index * header.recordSize);
+}
+
+inline int16_t Pyramid::min(const PyramidRecord& record, uint16_t channel) const
+{
+    int16_t value;
+    memcpy(&value, (const uint8_t*)&record + sizeof(PyramidRecord) + channel * sizeof(int16_t), sizeof(value));
+    return value;
+}
+
+inline int16_t Pyramid::max(const PyramidRecord& record, uint16_t channel) const
+{
+    int16_t value;
+    memcpy(&value, (const uint8_t*)&record + sizeof(PyramidRecord) + (header.valueCount + channel) * sizeof(int16_t), sizeof(value));
+    return value;
+}
+
+inline bool Pyramid::intersects(const PyramidRecord& r, uint64_t from, uint64_t to, const PyramidBox* box) const
+{
+    if (r.end < from || r.start > to)
+        return false;
+
+    if (!box)
+        return true;
+
+    return r.hasPosition && r.maxLat >= box->minLat && r.minLat <= box->maxLat
+        && r.maxLon >= box->minLon && r.minLon <= box->maxLon;
+}
+
+// Finds the finest level at which no more than maxRecords records cover the
+// time window [from, to] (elapsed micros) and the optional box, refining from
+// the top record down through the children of each match. Returns the level,
+// or -1 for an empty pyramid; indices receives the matching records in order.
+inline int Pyramid::select(uint64_t from, uint64_t to, const PyramidBox* box, size_t maxRecords, std::vector<uint64_t>& indices) const
+{
+    indices.clear();
+
+    if (header.levelCount == 0)
+        return -1;
+
+    int level = header.levelCount - 1;
+    for (uint64_t i = 0; i < levels[level].count; i++)
+        if (intersects(record(level, i), from, to, box))
+            indices.push_back(i);
+
+    std::vector<uint64_t> children;
+
+    while (level > 0)
+    {
+        children.clear();
+        uint64_t count = levels[level - 1].count;
+
+        for (size_t p = 0; p < indices.size() && children.size() <= maxRecords; p++)
+        {
+            uint64_t first = indices[p] * header.factor;
+            uint64_t last = std::min(first + header.factor, count);
+
+            for (uint64_t i = first; i < last; i++)
+                if (intersects(record(level - 1, i), from, to, box))
+                    children.push_back(i);
+        }
+
+        if (children.size() > maxRecords)
+            break;
+
+        indices.swap(children);
+        level--;
+    }
+
+    return level;
+}
+
+#endif
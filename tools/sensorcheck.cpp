@@ -0,0 +1,88 @@
+// Host check for the analog sensor profiles (datalogger/sensors.h).
+//
+//   sensorcheck
+//
+// Runs every ADC count through linearize() and compares it with the curve
+// the profile was built from. The oil pressure sender must read exactly 0
+// and full scale outside its 0.5-4.5 V range, including the counts between
+// a knee and the next table point.
+//
+// Exits non-zero if any profile is off by more than its tolerance.
+//
+// Build: g++ -std=c++17 -O2 -o sensorcheck tools/sensorcheck.cpp
+
+#include "../datalogger/sensors.h"
+#include "../datalogger/sensors.cpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef LinearCurve<102, 0, 922, 10000> OilCurve;
+typedef NtcCurve<10000, 3950, 2200> NtcProfile;
+typedef LoadedPotCurve<5000, 47000> ThrottleCurve;
+
+static double oilPressure(uint16_t count)
+{
+    double value = 10000.0 * ((double)count - 102) / (922 - 102);
+    return value < 0 ? 0 : (value > 10000 ? 10000 : value);
+}
+
+// Largest difference between linearize() and the exact curve over counts
+// [from, to], where exact() evaluates the curve directly.
+template <typename Exact>
+static int worstError(const char name[], const int16_t* table, uint16_t from, uint16_t to, Exact exact, int tolerance)
+{
+    int worst = 0;
+    uint16_t worstCount = from;
+
+    for (uint16_t count = from; count <= to; count++)
+    {
+        int error = abs(linearize(table, count) - (int)(exact(count) + (exact(count) < 0 ? -0.5 : 0.5)));
+        if (error > worst)
+        {
+            worst = error;
+            worstCount = count;
+        }
+    }
+
+    printf("%-10s counts %4u..%-4u  worst error %3d at %4u (tolerance %d)\n", name, from, to, worst, worstCount, tolerance);
+    return worst <= tolerance;
+}
+
+static bool expect(const char name[], const int16_t* table, uint16_t count, int16_t value)
+{
+    int16_t actual = linearize(table, count);
+
+    if (actual == value)
+        return true;
+
+    printf("%-10s count %4u: %d, expected %d\n", name, count, actual, value);
+    return false;
+}
+
+int main()
+{
+    bool ok = true;
+
+    //Knees and the counts around them
+    const uint16_t oilLow[] = { 0, 96, 100, 101, 102 };
+    const uint16_t oilHigh[] = { 922, 923, 928, 960, 1023 };
+
+    for (uint16_t count : oilLow)
+        ok &= expect("oil", SENSOR_OIL_PRESSURE_10BAR, count, 0);
+
+    for (uint16_t count : oilHigh)
+        ok &= expect("oil", SENSOR_OIL_PRESSURE_10BAR, count, 10000);
+
+    ok &= worstError("oil", SENSOR_OIL_PRESSURE_10BAR, 0, 1023, oilPressure, 1);
+
+    //Curved profiles: only as good as the table spacing, checked away from the rails
+    ok &= worstError("ntc", SENSOR_NTC_10K_3950, 64, 960,
+        [](uint16_t count) { return (double)NtcProfile::at(count); }, 15);
+    ok &= worstError("throttle", SENSOR_THROTTLE_5K, 0, 1023,
+        [](uint16_t count) { return (double)ThrottleCurve::at(count); }, 5);
+
+    ok &= expect("raw", SENSOR_RAW, 512, 512);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,411 @@
+// Live viewer for the datalogger's binary telemetry stream.
+//
+//   telemetryview <serial device | file | -> [--baud 250000] [--csv] [--record <file>]
+//
+// Reads COBS framed telemetry (see datalogger/telemetry.h) from a serial port,
+// a capture file or stdin, and redraws per-channel sparklines and aggregates
+// a few times a second. With --csv every sample is written to stdout instead.
+// --record stores the raw byte stream so a session can be replayed later.
+//
+// Build: g++ -std=c++17 -O2 -o telemetryview tools/telemetryview.cpp
+
+#include "logformat.h"
+
+#include <algorithm>
+#include <deque>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+#else
+#include <termios.h>
+#endif
+
+const unsigned char TLM_SAMPLE_ID = 0x01;
+const unsigned char TLM_STATS_ID = 0x02;
+const unsigned char TLM_TEXT_ID = 0x03;
+const size_t MAX_FRAME = 256;
+const size_t HISTORY = 60;
+const int REDRAW_MS = 250;
+
+struct ChannelView {
+    std::deque<int32_t> history;
+    int32_t last = 0;
+    int32_t min = INT32_MAX;
+    int32_t max = INT32_MIN;
+    double sum = 0;
+    uint64_t count = 0;
+};
+
+struct LinkStats {
+    uint64_t frames = 0;
+    uint64_t badFrames = 0; //COBS or checksum failures
+    uint64_t lostFrames = 0; //Gaps in the sequence counter
+    uint64_t samples = 0;
+    int lastSequence = -1;
+};
+
+struct DeviceStats {
+    bool valid = false;
+    uint32_t micros = 0;
+    uint16_t sent = 0, dropped = 0, decimation = 0, maxLoop = 0;
+    uint8_t logging = 0, fixType = 0, numSV = 0;
+};
+
+struct Viewer {
+    bool csv = false;
+    LinkStats link;
+    DeviceStats device;
+    LogSample sample = {};
+    uint16_t valueCount = 0;
+    std::vector<ChannelView> channels;
+    std::deque<std::string> messages;
+    uint64_t samplesAtRedraw = 0;
+    double lastRedraw = 0;
+    double sampleRate = 0;
+};
+
+static double now()
+{
+    timeval tv;
+    gettimeofday(&tv, nullptr);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static bool configureSerial(int fd, unsigned long baud)
+{
+#if defined(__linux__)
+    //termios2 accepts arbitrary rates such as the logger's 250000 baud
+    termios2 tio;
+    if (ioctl(fd, TCGETS2, &tio) != 0)
+        return false;
+
+    tio.c_iflag = 0;
+    tio.c_oflag = 0;
+    tio.c_lflag = 0;
+    tio.c_cflag = CS8 | CREAD | CLOCAL | BOTHER;
+    tio.c_ispeed = baud;
+    tio.c_ospeed = baud;
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    return ioctl(fd, TCSETS2, &tio) == 0;
+#else
+    termios tio;
+    if (tcgetattr(fd, &tio) != 0)
+        return false;
+
+    cfmakeraw(&tio);
+    tio.c_cflag |= CREAD | CLOCAL;
+    cfsetspeed(&tio, baud);
+    return tcsetattr(fd, TCSANOW, &tio) == 0;
+#endif
+}
+
+static size_t cobsDecode(const uint8_t* in, size_t length, uint8_t* out)
+{
+    size_t read = 0, written = 0;
+
+    while (read < length)
+    {
+        uint8_t code = in[read++];
+
+        if (code == 0 || read + code - 1 > length)
+            return 0;
+
+        for (uint8_t i = 1; i < code; i++)
+            out[written++] = in[read++];
+
+        if (code < 0xFF && read < length)
+            out[written++] = 0x00;
+    }
+
+    return written;
+}
+
+static void handleSample(Viewer& v, const uint8_t* payload, size_t length)
+{
+    if (length < LOG_LINE_FIXED_SIZE || (length - LOG_LINE_FIXED_SIZE) % 2)
+        return;
+
+    uint16_t valueCount = (length - LOG_LINE_FIXED_SIZE) / 2;
+    if (valueCount > LOG_MAX_VALUES)
+        return;
+
+    if (valueCount != v.valueCount)
+    {
+        v.valueCount = valueCount;
+        v.channels.assign(valueCount, ChannelView());
+    }
+
+    decodeLogLine(payload, valueCount, v.sample);
+    v.link.samples++;
+
+    for (uint16_t i = 0; i < valueCount; i++)
+    {
+        ChannelView& c = v.channels[i];
+        int32_t value = channelValue(v.sample, i);
+
+        c.last = value;
+        c.min = std::min(c.min, value);
+        c.max = std::max(c.max, value);
+        c.sum += value;
+        c.count++;
+        c.history.push_back(value);
+
+        if (c.history.size() > HISTORY)
+            c.history.pop_front();
+    }
+
+    if (v.csv)
+    {
+        const LogSample& s = v.sample;
+        printf("%u,%u,%u,%d,%d,%d,%u,%u,%u", s.micros, s.speed, s.sAcc, s.lat, s.lon, s.alt, s.hAcc, s.vAcc, s.fixType);
+
+        for (uint16_t i = 0; i < valueCount; i++)
+            printf(",%d", channelValue(s, i));
+
+        printf("\n");
+    }
+}
+
+static void handleStats(Viewer& v, const uint8_t* payload, size_t length)
+{
+    if (length < 15)
+        return;
+
+    v.device.valid = true;
+    v.device.micros = readU32(payload);
+    v.device.sent = readU16(payload + 4);
+    v.device.dropped = readU16(payload + 6);
+    v.device.decimation = readU16(payload + 8);
+    v.device.maxLoop = readU16(payload + 10);
+    v.device.logging = payload[12];
+    v.device.fixType = payload[13];
+    v.device.numSV = payload[14];
+}
+
+static void handleFrame(Viewer& v, const uint8_t* encoded, size_t length)
+{
+    uint8_t frame[MAX_FRAME];
+    size_t size = cobsDecode(encoded, length, frame);
+
+    if (size < 4)
+    {
+        v.link.badFrames++;
+        return;
+    }
+
+    uint8_t ckA = 0, ckB = 0;
+    for (size_t i = 0; i < size - 2; i++)
+    {
+        ckA += frame[i];
+        ckB += ckA;
+    }
+
+    if (ckA != frame[size - 2] || ckB != frame[size - 1])
+    {
+        v.link.badFrames++;
+        return;
+    }
+
+    v.link.frames++;
+
+    uint8_t sequence = frame[1];
+    if (v.link.lastSequence >= 0)
+        v.link.lostFrames += (uint8_t)(sequence - v.link.lastSequence - 1);
+    v.link.lastSequence = sequence;
+
+    const uint8_t* payload = frame + 2;
+    size_t payloadLength = size - 4;
+
+    switch (frame[0])
+    {
+        case TLM_SAMPLE_ID:
+            handleSample(v, payload, payloadLength);
+            break;
+        case TLM_STATS_ID:
+            handleStats(v, payload, payloadLength);
+            break;
+        case TLM_TEXT_ID:
+            v.messages.push_back(std::string((const char*)payload, payloadLength));
+            if (v.messages.size() > 5)
+                v.messages.pop_front();
+            break;
+        default:
+            break;
+    }
+}
+
+static const char* sparkline(const ChannelView& c, std::string& out)
+{
+    static const char* blocks[] = { "▁", "▂", "▃", "▄", "▅", "▆", "▇", "█" };
+    out.clear();
+
+    int32_t lo = INT32_MAX, hi = INT32_MIN;
+    for (int32_t value : c.history)
+    {
+        lo = std::min(lo, value);
+        hi = std::max(hi, value);
+    }
+
+    for (int32_t value : c.history)
+        out += blocks[hi > lo ? (value - lo) * 7 / (hi - lo) : 0];
+
+    return out.c_str();
+}
+
+static void redraw(Viewer& v)
+{
+    double t = now();
+    double elapsed = t - v.lastRedraw;
+
+    if (elapsed > 0)
+        v.sampleRate = (v.link.samples - v.samplesAtRedraw) / elapsed;
+
+    v.samplesAtRedraw = v.link.samples;
+    v.lastRedraw = t;
+
+    if (v.csv)
+        return;
+
+    const LogSample& s = v.sample;
+    std::string line;
+
+    printf("\033[H\033[2J");
+    printf("link: %llu frames, %llu bad, %llu lost, %.0f samples/s\n",
+        (unsigned long long)v.link.frames, (unsigned long long)v.link.badFrames,
+        (unsigned long long)v.link.lostFrames, v.sampleRate);
+
+    if (v.device.valid)
+        printf("logger: %s, 1/%u decimation, sent %u, dropped %u, max loop %u us, fix %u, %u SV\n",
+            v.device.logging ? "LOGGING" : "idle", v.device.decimation, v.device.sent,
+            v.device.dropped, v.device.maxLoop, v.device.fixType, v.device.numSV);
+
+    printf("gps: %.1f km/h  %.7f %.7f  alt %.1f m  hAcc %.1f m  fix %u\n\n",
+        s.speed * 0.0036, s.lat * 1e-7, s.lon * 1e-7, s.alt * 1e-3, s.hAcc * 1e-3, s.fixType);
+
+    for (uint16_t i = 0; i < v.valueCount; i++)
+    {
+        const ChannelView& c = v.channels[i];
+        printf("%-4s %6d  min %6d  max %6d  mean %7.1f  %s\n",
+            channelName(i).c_str(), c.last, c.min, c.max,
+            c.count ? c.sum / c.count : 0.0, sparkline(c, line));
+    }
+
+    if (!v.messages.empty())
+        printf("\n");
+
+    for (const std::string& message : v.messages)
+        printf("> %s\n", message.c_str());
+
+    fflush(stdout);
+}
+
+static int usage()
+{
+    fprintf(stderr, "usage: telemetryview <serial device | file | -> [--baud 250000] [--csv] [--record <file>]\n");
+    return 2;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+        return usage();
+
+    const char* source = argv[1];
+    unsigned long baud = 250000;
+    const char* recordPath = nullptr;
+    Viewer v;
+
+    for (int i = 2; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--baud") && i + 1 < argc)
+            baud = strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--csv"))
+            v.csv = true;
+        else if (!strcmp(argv[i], "--record") && i + 1 < argc)
+            recordPath = argv[++i];
+        else
+            return usage();
+    }
+
+    int fd = strcmp(source, "-") ? open(source, O_RDONLY | O_NOCTTY) : STDIN_FILENO;
+
+    if (fd < 0)
+    {
+        perror(source);
+        return 1;
+    }
+
+    if (isatty(fd) && !configureSerial(fd, baud))
+    {
+        fprintf(stderr, "%s: could not set %lu baud\n", source, baud);
+        return 1;
+    }
+
+    FILE* record = nullptr;
+    if (recordPath && !(record = fopen(recordPath, "wb")))
+    {
+        perror(recordPath);
+        return 1;
+    }
+
+    uint8_t input[4096];
+    uint8_t encoded[MAX_FRAME];
+    size_t encodedLength = 0;
+    bool overflow = false;
+
+    v.lastRedraw = now();
+
+    while (true)
+    {
+        pollfd p = { fd, POLLIN, 0 };
+        int ready = poll(&p, 1, REDRAW_MS);
+
+        if (ready > 0)
+        {
+            ssize_t count = read(fd, input, sizeof(input));
+
+            if (count <= 0)
+                break;
+
+            if (record)
+                fwrite(input, 1, count, record);
+
+            for (ssize_t i = 0; i < count; i++)
+            {
+                uint8_t c = input[i];
+
+                if (c == 0x00)
+                {
+                    if (overflow)
+                        v.link.badFrames++;
+                    else if (encodedLength > 0)
+                        handleFrame(v, encoded, encodedLength);
+
+                    encodedLength = 0;
+                    overflow = false;
+                }
+                else if (encodedLength < sizeof(encoded))
+                    encoded[encodedLength++] = c;
+                else
+                    overflow = true;
+            }
+        }
+
+        if (now() - v.lastRedraw >= REDRAW_MS / 1000.0)
+            redraw(v);
+    }
+
+    redraw(v);
+
+    if (record)
+        fclose(record);
+
+    return 0;
+}